@@ -40,6 +40,31 @@
 //      3.6.1   turbo zero
 //      3.6.2   SIMD case
 //      3.7     start addr
+//      3.8     write journal
+//      3.9     piece table
+//      3.10    save as
+//      3.11    range ops
+//      3.12    replace all
+//      3.12.1  table render
+//      3.12.2  key folding
+//      3.12.3  block cache
+//      3.12.4  direct render
+//      3.13    wide rows
+//      3.13.1  shared cache
+//      3.13.2  more views
+//      3.14    follow mode
+//      3.15    entropy map
+//      3.16    checksums
+//      3.17    strings
+//      3.18    carving
+//      3.19    typed search
+//      3.20    approximate search
+//      3.21    shift/xor search
+//      3.22    kernel dispatch
+//      3.23    benchmark
+//      3.24    self test
+//      3.25    metrics
+//      3.26    record / replay
 //
 //   This program is free software; you can redistribute it and/or
 //   modify it under the terms of the GNU General Public License as
@@ -58,16 +83,28 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <time.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <linux/fs.h>
 #include <err.h>
 
 #include <string>
 #include <deque>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <functional>
 
 #include <ncurses.h>
 
 using namespace std;
 
-#define VBL_VERSION     "3.7"
+#define VBL_VERSION     "3.26"
 
 /* set Cursor Color in input window:
    - set it when curs_set(2) has no effect
@@ -83,11 +120,53 @@ using namespace std;
 #define SET_CURSOR_COLOR        0
 #endif
 
+/* keep a sidecar journal for crash-safe insert/delete writes:
+   - file.vbl-journal next to regular files
+   - /var/tmp/vbl<path>.journal for devices
+
+   - without it an interrupted write can only be undone
+     while vbl is still running */
+#ifndef WRITE_JOURNAL
+#define WRITE_JOURNAL           1
+#endif
+
+/* write the hex/ASCII panes with ANSI sequences of their own:
+   - diffed against a shadow of the terminal, not refreshed by ncurses
+   - only the changed cells of a row, scrolling by scroll regions
+
+   - ncurses keeps the input, the status lines and the popups
+
+   - needs a VT100/xterm compatible terminal with colors
+
+   - meson setup -Ddirect_render=true vbl */
+#ifndef DIRECT_RENDER
+#define DIRECT_RENDER           0
+#endif
+
 /* show a summary in edit insert/delete after large writes */
 #ifndef SHOW_WRITE_SUMMARY
 #define SHOW_WRITE_SUMMARY      0
 #endif
 
+/* build the benchmark runner instead of the viewer:
+   - vbl-bench [dir [MB]] writes synthetic files to dir
+   - one JSON line per hot path and file, in GB/s
+
+   - meson test --benchmark */
+#ifndef BENCHMARK
+#define BENCHMARK               0
+#endif
+
+/* build the search self test instead of the viewer:
+   - vbl-test [dir [rounds [seed]]] fuzzes files in dir
+   - moveForw / moveBack against a naive search, every kernel
+   - exit status 1 on the first mismatches
+
+   - meson test */
+#ifndef SELFTEST
+#define SELFTEST                0
+#endif
+
 bool debug = 1;
 /* curses debug:
 f=/tmp/.vbl
@@ -111,10 +190,15 @@ vbl file 2>$f; cat $f
 #define mScale          count   / (scale ? scale : 1)
 #define mScaleInc       count++ / (scale ? scale : 1)
 
+#define KEY_CTRL_B      0x02
 #define KEY_CTRL_C      0x03
+#define KEY_CTRL_F      0x06
+#define KEY_CTRL_G      0x07
 #define KEY_TAB         0x09
 #define KEY_CTRL_K      0x0B
+#define KEY_CTRL_L      0x0C
 #define KEY_RETURN      0x0D
+#define KEY_CTRL_R      0x12
 #define KEY_CTRL_U      0x15
 #define KEY_ESCAPE      0x1B
 #define KEY_DELETE      0x7F
@@ -200,7 +284,6 @@ typedef off_t           FPos;  // long int
 typedef ssize_t         Size;  // long int
 
 typedef deque<string>   StrDeq;
-typedef deque<Byte>     BytDeq;
 
 enum LockState { lockNeither, lockTop, lockBottom };
 
@@ -247,6 +330,16 @@ const Command   cmShowRaster   = 11;
 const Command   cmShowHelp     = 12;
 const Command   cmSmartScroll  = 13;
 const Command   cmQuit         = 14;
+const Command   cmReplace      = 15;
+const Command   cmLineWidth    = 16;
+const Command   cmFollow       = 17;
+const Command   cmShowMap      = 18;
+const Command   cmChecksum     = 19;
+const Command   cmStrings      = 20;
+const Command   cmMetrics      = 21;
+const Command   cmAddView      = 22;
+const Command   cmCloseView    = 23;
+const Command   cmNextView     = 24;
 
 //--------------------------------------------------------------------
 
@@ -257,9 +350,25 @@ const Size minScreenHeight = 24,  // Enforced minimum height
            skipBack = 1,  // Percent to skip backward
 
            staticSize = 1 << 24,  // size global buffers
+           cacheBlock = 1 << 16,  // viewport cache block
+           cacheSlots = 16,       // blocks cached per file
            warnResize = 1 << 29,  // confirmation threshold
+           jrnlSpan   = 1 << 30,  // journal mark at least every GB
+           jrnlSecs   = 10,       // or every 10 seconds
+           jrnlGroup  = 1 << 27,  // overlapping moves: bytes per journal mark
+           mapChunk   = 1 << 20,  // entropy map read per thread
+           mapCell    = 512,      // entropy map cell granularity
+           mapThreads = 8,
+           strChunk   = 1 << 22,  // strings index scan unit
+           strMin     = 6,        // shortest string
+           strMax     = 4096,     // longer ones are cut
+           strText    = 1 << 28,  // text kept at most
+
+           maxHistory = 20,
+
+           minViewLines = 4,    // rows of a pane, at least
 
-           maxHistory = 20;
+           maxLineWidth = 128;  // bytes per row of auto-fit
 
 const char *hexDigits     = "0123456789ABCDEF",                     // search
            *hexDigitsGoto = "0123456789ABCDEFabcdef%Xx+-kmgtKMGT",  // goto
@@ -287,7 +396,7 @@ const char *aHelp[] = {
 "  Goto [+-]{dec hex 0x x$}[%|kmgtKMGT]   +4% + * =  -1% -",
 "   last addr: get ' <  set l  last offset .  neg offset ,",
 "  ",
-"  Edit file   show Raster   Ignore case              Quit",
+"  Edit file   show Raster   Ignore case   Width      Quit",
 "  ",
 "                      --- One File ---",
 "  Enter == sm4rtscroll   Ascii mode",
@@ -302,19 +411,63 @@ const char *aHelp[] = {
 "  "
 };
 
+// page 2 - same size as page 1
+const char *aHelp2[] = {
+"  ",
+"                      --- Edit ---",
+"  PgDn PgUp == scroll file    Home End == view begin/end",
+"  Ctrl-B == undo  Ctrl-F == redo;  all edits in one write",
+"  ",
+"  Esc during a long write:      Resume  Undo  Later",
+"  ",
+"  Save changes:  y == in place    a == save as new file",
+"  ",
+"  Ctrl-L == mark    Ctrl-R == range: Fill Copy Delete",
+"  Ctrl-G == goto position",
+"  ",
+"  s == replace all, then review in edit mode (Esc: save)",
+"  ",
+"  fOllow growing files;  the end in view stays pinned",
+"  Map of entropy: jump to zero, text or dense parts",
+"  Checksum last addr..here or whole file, both files",
+"  eXtract strings (ASCII, UTF-16), filter, jump",
+"  Data rate of the last search, diff, scroll, write",
+"  V == one more view   Tab == next view   K == close view",
+"  "
+};
+
 const int longestLine = 57;  // adjust!
 
 const Byte aBold[] = {  // hotkeys, start y:1, x:1
         4,3,  4,10, 4,15,
         6,3,  6,46, 6,48, 6,50,  6,57,
         7,19, 7,21,  7,28,  7,43,  7,57,
-        9,3,  9,20,  9,29,  9,54,
+        9,3,  9,20,  9,29,  9,43,  9,54,
         12,26,
         15,23, 15,25,  15,41, 15,43,
         16,32, 16,47,
         0
 };
 
+const Byte aBold2[] = {
+        6,33, 6,41, 6,47,
+        8,18, 8,35,
+        10,38, 10,43, 10,48,
+        13,3,
+        15,4,
+        16,3,
+        17,3,
+        18,4,
+        19,3,
+        20,3, 20,43,
+        0
+};
+
+const char **aHelpPage[] = { aHelp,  aHelp2  };
+const Byte  *aBoldPage[] = { aBold,  aBold2  };
+
+const int helpPages = sizeof(aHelpPage) / sizeof(aHelpPage[0]);
+
 const char *helpVersion = " VBinDiff for Linux " VBL_VERSION " ";
 
 const int helpWidth  = 1 + longestLine + 2                  + 1,
@@ -343,6 +496,23 @@ bool singleFile,
 
 int haveDiff;
 
+int moveNet;  // folded moves of getCommand
+
+int widthWanted;  // bytes per row, 0 == auto-fit
+
+int panes = 1;   // on screen: the file or the pair, then the views
+int viewFocus;   // 1.. == that view takes moves, finds and gotos
+
+int followFd = -1;  // inotify, follow mode on
+
+bool directVT;   // DIRECT_RENDER and colors
+bool headless;   // curses on /dev/null, no pauses
+string vtOut;    // pending output of the panes
+attr_t vtAttr;   // last attribute sent
+short vtY, vtX;  // cursor after the last cell sent
+vector<chtype> vtShown;  // the terminal as direct output left it, 0 == unknown
+vector<Byte>   vtStale;  // per screen row: cells unknown, send it again
+
 LockState lockState;
 
 string lastSearch,
@@ -350,10 +520,10 @@ string lastSearch,
 
 StrDeq hexSearchHistory,
        textSearchHistory,
-       positionHistory;
-
-BytDeq editBytes,
-       editColor;
+       positionHistory,
+       fileNameHistory,
+       filterHistory,
+       valueHistory;
 
 // Set dynamically for 16/24/32 byte width
 int screenWidth,   // Number of columns in curses
@@ -368,6 +538,120 @@ int screenWidth,   // Number of columns in curses
     searchIndent,  // Lines of search result indentation
     steps[4];      // Number of bytes to move for each step
 
+//====================================================================
+// Operation metrics  ##:metric
+//
+// The file I/O wrappers and the view cache count into io, a Measure
+// books the difference over its scope to one operation, the outermost
+// wins.  Worker threads (map, strings, checksum) are not counted.
+// Wall against cpu time tells an I/O bound operation from a CPU bound.
+
+enum MetricOp { opSearch, opDiff, opScroll, opWrite, opCount };
+
+const char *metricName[opCount] = { "search", "diff", "scroll", "write" };
+
+struct Metric {
+        Full    runs,
+                bytesRead,
+                bytesWritten,
+                syscalls,
+                cacheHits,
+                cacheMisses,
+                wallNs,
+                cpuNs;
+};
+
+Metric io,                // running counters
+       metrics[opCount],  // totals per operation
+       lastMetric;        // the last operation
+
+Full pausedNs;            // nap() for the eye, not work
+
+int  lastOp = -1;
+bool showMetrics;         // status overlay
+
+Full clockNs(clockid_t clock)
+{
+        timespec ts;
+
+        clock_gettime(clock, &ts);
+
+        return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+class Measure
+{
+        static int              depth;
+
+        int                     op;
+        Metric                  start;
+        Full                    paused;
+
+    public:
+                Measure(int Op): op(Op), start(io), paused(pausedNs)
+                {
+                        if (! depth++) {
+                                start.wallNs = clockNs(CLOCK_MONOTONIC);
+                                start.cpuNs  = clockNs(CLOCK_THREAD_CPUTIME_ID);
+                        }
+                }
+               ~Measure();
+};
+
+int Measure::depth;
+
+Measure::~Measure()
+{
+        if (--depth) {
+                return;
+        }
+
+        Metric& m = lastMetric;
+        Metric& t = metrics[op];
+
+        m.runs         = 1;
+        m.bytesRead    = io.bytesRead    - start.bytesRead;
+        m.bytesWritten = io.bytesWritten - start.bytesWritten;
+        m.syscalls     = io.syscalls     - start.syscalls;
+        m.cacheHits    = io.cacheHits    - start.cacheHits;
+        m.cacheMisses  = io.cacheMisses  - start.cacheMisses;
+        m.wallNs       = clockNs(CLOCK_MONOTONIC)         - start.wallNs - (pausedNs - paused);
+        m.cpuNs        = clockNs(CLOCK_THREAD_CPUTIME_ID) - start.cpuNs;
+
+        t.runs         += 1;
+        t.bytesRead    += m.bytesRead;
+        t.bytesWritten += m.bytesWritten;
+        t.syscalls     += m.syscalls;
+        t.cacheHits    += m.cacheHits;
+        t.cacheMisses  += m.cacheMisses;
+        t.wallNs       += m.wallNs;
+        t.cpuNs        += m.cpuNs;
+
+        lastOp = op;
+} // end Measure
+
+//--------------------------------------------------------------------
+// Overlay: last operation, throughput, share of cpu and cache hits
+
+char *metricText(char* out)
+{
+        const Metric& m = lastMetric;
+
+        Full bytes = m.bytesRead + m.bytesWritten,
+             look  = m.cacheHits + m.cacheMisses,
+             wall  = max<Full>(m.wallNs, 1);
+
+        int len = sprintf(out, " %s %.2fGB/s %.1fMB %luio cpu%lu%% %.0fms",
+                        metricName[lastOp], (double) bytes / wall, bytes / 1e6, m.syscalls,
+                        min<Full>(m.cpuNs * 100 / wall, 100), m.wallNs / 1e6);
+
+        if (look) {
+                sprintf(out + len, " hit%lu%%", m.cacheHits * 100 / look);
+        }
+
+        return out;
+}
+
 //====================================================================
 // Global Functions
 
@@ -384,6 +668,8 @@ bool WriteFile(File file, const Byte* buf, Size cnt)
         while (cnt > 0) {
                 Size bytesWritten = write(file, buf, cnt);
 
+                ++io.syscalls;
+
                 if (bytesWritten < 1) {
                         if (errno == EINTR)
                                 bytesWritten = 0;
@@ -393,15 +679,15 @@ bool WriteFile(File file, const Byte* buf, Size cnt)
 
                 buf += bytesWritten;
                 cnt -= bytesWritten;
+
+                io.bytesWritten += bytesWritten;
         }
 
         return true;
 }
 
-Size ReadFile(File file, Byte* buf, Size cnt)
+void PollEscape()
 {
-        Size ret = read(file, buf, cnt);
-
         /* interrupt the searches */
         timeout(0);
         switch(getch()) {
@@ -409,2773 +695,8792 @@ Size ReadFile(File file, Byte* buf, Size cnt)
                         stopRead = true;
         }
         timeout(-1);
-
-        return ret;
 }
 
-FPos SeekFile(File file, FPos position, int whence=SEEK_SET)
+Size ReadFile(File file, Byte* buf, Size cnt)
 {
-        return lseek(file, position, whence);
+        Size ret = read(file, buf, cnt);
+
+        ++io.syscalls;
+        io.bytesRead += max<Size>(ret, 0);
+
+        PollEscape();
+
+        return ret;
 }
 
 //--------------------------------------------------------------------
-// Initialize ncurses  ##:i
+// Positioned I/O of the main thread, counted
 
-bool initialize()
+Size ReadAt(File file, void* buf, Size cnt, FPos pos)
 {
-        setlocale(LC_ALL, "");  // for Unicode blocks
+        Size ret = pread(file, buf, cnt, pos);
 
-        if (! initscr()) {
-                return false;
-        }
+        ++io.syscalls;
+        io.bytesRead += max<Size>(ret, 0);
 
-        set_escdelay(10);
-        keypad(stdscr, true);
+        return ret;
+}
 
-        nonl();
-        cbreak();
-        noecho();
+Size WriteAt(File file, const void* buf, Size cnt, FPos pos)
+{
+        Size ret = pwrite(file, buf, cnt, pos);
 
-        if (has_colors()) {
-                start_color();
+        ++io.syscalls;
+        io.bytesWritten += max<Size>(ret, 0);
 
-                init_pair(pairWhiteBlue,   COLOR_WHITE,  COLOR_BLUE);
-                init_pair(pairBlackWhite,  COLOR_BLACK,  COLOR_WHITE);
-                init_pair(pairRedWhite,    COLOR_RED,    COLOR_WHITE);
-                init_pair(pairYellowBlue,  COLOR_YELLOW, COLOR_BLUE);
-                init_pair(pairGreenBlue,   COLOR_GREEN,  COLOR_BLUE);
-                init_pair(pairBlackCyan,   COLOR_BLACK,  COLOR_CYAN);
-                init_pair(pairGreenBlack,  COLOR_GREEN,  COLOR_BLACK);
-                init_pair(pairWhiteCyan,   COLOR_WHITE,  COLOR_CYAN);
-                init_pair(pairWhiteRed,    COLOR_WHITE,  COLOR_RED);
-                init_pair(pairBlackYellow, COLOR_BLACK,  COLOR_YELLOW);
-        }
+        return ret;
+}
 
-        curs_set(0);
+//--------------------------------------------------------------------
+// Make a rename durable
 
-        return true;
-} // end initialize
+void SyncDir(const string& path)
+{
+        string dir = path.substr(0, path.rfind('/') + 1);
+        File dfd = open(dir.size() ? dir.c_str() : ".", O_RDONLY);
+
+        if (dfd >= 0) {
+                fsync(dfd);
+                close(dfd);
+        }
+}
 
 //--------------------------------------------------------------------
-// Visible difference between insert and overstrike mode
+// Copy a file range: reflink the block aligned part, then
+// copy_file_range, then read/write
 
-void showCursor(bool over=false)
+bool CopyRange(File src, FPos from, File dst, FPos to, Size len, Size blk=0)
 {
-        over ? curs_set(2) : curs_set(1);
+        if (blk && (from - to) % blk == 0) {
+                FPos lo = (from + blk - 1) / blk * blk,
+                     hi = (from + len) / blk * blk;
 
-#if SET_CURSOR_COLOR
-        over ? printf("\e]12;%s\a", colorDelete) : printf("\e]12;%s\a", colorInsert);
+                if (hi > lo) {
+                        file_clone_range fcr = { src, (Full) lo, (Full) (hi - lo), (Full) (to + lo - from) };
 
-        fflush(stdout);
-#endif
-}
+                        ++io.syscalls;
 
-void hideCursor()
-{
-        curs_set(0);
-}
+                        if (ioctl(dst, FICLONERANGE, &fcr) == OK) {
+                                return CopyRange(src, from, dst, to, lo - from) &&
+                                       CopyRange(src, hi, dst, to + hi - from, from + len - hi);
+                        }
+                }
+        }
 
-//--------------------------------------------------------------------
-// Shutdown ncurses
+        while (len > 0) {
+                loff_t in  = from,
+                       out = to;
 
-void shutdown()
-{
-        delwin(winInput);
-        delwin(winHelp);
+                Size cnt = copy_file_range(src, &in, dst, &out, len, 0);
 
-        showCursor();
+                ++io.syscalls;
 
-        endwin();
-}
+                if (cnt <= 0) {
+                        break;  // other file system, kernel too old
+                }
 
-//--------------------------------------------------------------------
-// Error exit ncurses
+                io.bytesRead    += cnt;
+                io.bytesWritten += cnt;
 
-void exitMsg(int status, const char* message)
+                from += cnt;
+                to   += cnt;
+                len  -= cnt;
+        }
+
+        while (len > 0) {
+                Size cnt = ReadAt(src, buffer, min(len, staticSize), from);
+
+                if (cnt <= 0 || WriteAt(dst, buffer, cnt, to) != cnt) {
+                        return false;
+                }
+
+                from += cnt;
+                to   += cnt;
+                len  -= cnt;
+        }
+
+        return true;
+} // end CopyRange
+
+FPos SeekFile(File file, FPos position, int whence=SEEK_SET)
 {
-        shutdown();
+        ++io.syscalls;
 
-        errx(status, message);
+        return lseek(file, position, whence);
 }
 
 //--------------------------------------------------------------------
-// Reset variables for ascii mode
+// Direct VT output of the panes  ##:vt
 
-void setViewMode()
+/* one SGR parameter, 0..47 */
+char* vtNum(char* pb, int n)
 {
-        lineWidth = modeAscii ? lineWidthAsc : lineWidthAsc / 4;
+        if (n >= 10) {
+                *pb++ = '0' + n / 10;
+        }
+        *pb++ = '0' + n % 10;
+        *pb++ = ';';
 
-        bufSize = numLines * lineWidth;
+        return pb;
+}
 
-        searchIndent = lineWidth * 3;
+void vtCell(chtype c)
+{
+        attr_t attr = c & A_ATTRIBUTES;
 
-        steps[cmmMoveByte] = 1;
-        steps[cmmMoveLine] = lineWidth;
-        steps[cmmMovePage] = bufSize - lineWidth;
-        steps[cmmMoveAll]  = 0;
-}
+        if (attr != vtAttr) {  // only what changed
+                char buf[24] = "\e[",
+                     *pb = buf + 2;
+                short fg, bg,
+                      was[2] = { -1, -1 };
 
-//--------------------------------------------------------------------
-// Set variables for dynamic width  ##:y
+                pair_content(PAIR_NUMBER(attr), &fg, &bg);
 
-void calcScreenLayout()
-{
-        if (COLS < minScreenWidth) {
-                string err("The screen must be at least " + to_string(minScreenWidth) + " characters wide.");
+                if (vtAttr != (attr_t) -1) {
+                        pair_content(PAIR_NUMBER(vtAttr), &was[0], &was[1]);
 
-                exitMsg(31, err.c_str());
-        }
+                        if ((attr ^ vtAttr) & A_BOLD) {
+                                pb = vtNum(pb, attr & A_BOLD ? 1 : 22);
+                        }
+                }
+                else {
+                        pb = vtNum(pb, 0);
 
-        if (LINES < minScreenHeight) {
-                string err("The screen must be at least " + to_string(minScreenHeight) + " lines high.");
+                        if (attr & A_BOLD) {
+                                pb = vtNum(pb, 1);
+                        }
+                }
 
-                exitMsg(32, err.c_str());
+                if (fg != was[0]) {
+                        pb = vtNum(pb, 30 + fg);
+                }
+                if (bg != was[1]) {
+                        pb = vtNum(pb, 40 + bg);
+                }
+                if (pb > buf + 2) {
+                        pb[-1] = 'm';
+                        vtOut.append(buf, pb - buf);
+                }
+                vtAttr = attr;
         }
 
-        short tera = sizeTera ? 3 : 0;  // use large addresses only if needed
+        vtOut += (char) (c & A_CHARTEXT);
+        ++vtX;
+}
 
-        leftMar = 11 + tera;
+void vtMove(short y, short x)
+{
+        char buf[24];
 
-        if (COLS >= 140 + tera) {
-                lineWidth   = 32;
-                screenWidth = 140 + tera;
-                leftMar2    = 108 + tera;
-        }
-        else if (COLS >= 108 + tera) {
-                lineWidth   = 24;
-                screenWidth = 108 + tera;
-                leftMar2    = 84  + tera;
+        if (y == vtY && x > vtX) {
+                sprintf(buf, "\e[%dC", x - vtX);
         }
         else {
-                lineWidth   = 16;
-                screenWidth = 76 + tera;
-                leftMar2    = 60 + tera;
+                sprintf(buf, "\e[%d;%dH", y + 1, x + 1);
         }
 
-        lineWidthAsc = lineWidth * 4;
-
-        inWidth = (sizeTera ? 15 : 11) + 1;  // sign
-
-        linesTotal = LINES;
+        vtOut += buf;
+        vtY = y;
+        vtX = x;
+}
 
-        numLines = linesTotal / (singleFile ? 1 : 2) - 1;
+/* ncurses tracks cursor and attributes, save and restore them */
+void flushVT()
+{
+        if (vtOut.empty()) {
+                return;
+        }
 
-        setViewMode();
-} // end calcScreenLayout
+        vtOut.insert(0, "\e7");
+        vtOut += "\e8";
 
-//--------------------------------------------------------------------
-// Convert a character to uppercase
+        WriteFile(STDOUT_FILENO, (const Byte*) vtOut.data(), vtOut.size());
 
-int upCase(int c)
-{
-        return (c >= 'a' && c <= 'z') ? c & ~0x20 : c;
+        vtOut.clear();
+        vtAttr = -1;
+        vtY    = -1;
 }
 
 //--------------------------------------------------------------------
-// Convert buffer to lowercase
+// Send the cells of a screen row that differ from the terminal
 
-void lowCase(Byte* buf, Size len)
+void vtLine(short y, const chtype* s, short n)
 {
-        Byte* b = bufFile1;  // movdqu ==> movdqa
+        chtype *shown = &vtShown[y * COLS];
 
-        if (len == staticSize) {  // SIMD
-                for (Size i=0; i < staticSize; ++i) {
-                        b[i] = b[i] >= 'A' && b[i] <= 'Z' ? b[i] | 0x20 : b[i];
+        for (short x = 0, at = -1; x < n; ++x) {
+                if (s[x] == shown[x]) {
+                        continue;
                 }
-        }
 
-        else {
-                for (Size i=0; i < len; ++i) {
-                        if (buf[i] <= 'Z' && buf[i] >= 'A') {
-                                buf[i] |= 0x20;
+                if (at < 0 || x - at > 6) {
+                        vtMove(y, x);
+                }
+                else {
+                        for (; at < x; ++at) {  // shorter than a move
+                                vtCell(s[at]);
                         }
                 }
+
+                vtCell(s[x]);
+                at = x + 1;
         }
+
+        memcpy(shown, s, n * sizeof(chtype));
+
+        vtStale[y] = 0;
 }
 
 //--------------------------------------------------------------------
-// Convert hex string to bytes
+// Scroll screen rows top..bottom with a scroll region
 
-int packHex(char* buf)
+void vtScroll(short top, short bottom, short n)
 {
-        Byte *pb = (Byte*) buf,
-             *po = pb;
+        char buf[40];
 
-        for (Byte b; (b = *pb); ++pb) {
-                if (b == ' ') {
-                        continue;
-                }
-                else {
-                        b = (b - (*pb++ > 64 ? 55 : 48)) << 4;
+        sprintf(buf, "\e[m\e[%d;%dr\e[%d%c\e[r", top + 1, bottom + 1, abs(n), n > 0 ? 'S' : 'T');
 
-                        b |= *pb - (*pb > 0x40 ? 0x37 : 0x30);
+        vtOut += buf;
+        vtAttr = -1;
+        vtY    = -1;  // cursor went home
 
-                        *po++ = b;
-                }
+        chtype *rows = &vtShown[top * COLS];
+        size_t  keep = (bottom - top + 1 - abs(n)) * COLS,
+                gone = abs(n) * COLS;
+
+        if (n > 0) {
+                memmove(rows, rows + gone, keep * sizeof(chtype));
+                memset(rows + keep, 0, gone * sizeof(chtype));
+        }
+        else {
+                memmove(rows + gone, rows, keep * sizeof(chtype));
+                memset(rows, 0, gone * sizeof(chtype));
         }
 
-        return po - (Byte*) buf;
+        memset(&vtStale[n > 0 ? bottom + 1 - n : top], 1, abs(n));
 }
 
 //--------------------------------------------------------------------
-// My pretty printer
+// Refresh a window over the panes: ncurses does not know what direct
+// output left under it, so it sends all of it, and the panes send
+// those cells again when they come back
 
-char *pretty(char *buffer, FPos *size, int sign)
+void refreshW(WINDOW *w)
 {
-        char aBuf[64],
-             *pa = aBuf,
-             *pb = buffer;
+        if (directVT) {
+                short x = getbegx(w),
+                      n = min(getmaxx(w), COLS - x);
 
-        sprintf(aBuf, (sign ? "%+ld" : "%ld"), *size);
+                for (short y = getbegy(w); y < getbegy(w) + getmaxy(w) && y < LINES; ++y) {
+                        memset(&vtShown[y * COLS + x], 0, n * sizeof(chtype));
 
-        int len = strlen(aBuf);
-
-        while (len) {
-                *pb++ = *pa++;
-
-                if (sign) {
-                        --sign;
-                        --len;
-                }
-                else {
-                        if (--len && ! (len % 3)) {
-                                if (thouSep) {
-                                        *pb++ = thouSep;
-                                }
-                        }
+                        vtStale[y] = 1;
                 }
+
+                redrawwin(w);
         }
-        *pb = 0;
 
-        return buffer;
-} // end pretty
+        wrefresh(w);
+}
 
 //--------------------------------------------------------------------
-// Help window
+// Session record and replay  ##:session
+//
+// VBL_RECORD=file writes each command of getCommand with its folded
+// move, then the keys read while it runs: popups, input strings,
+// edit mode.  VBL_REPLAY=file runs the commands headless.
+//
+//   s cols lines     screen size
+//   c cmd moveNet    command
+//   k key            key of the command before
+
+struct Replay {
+        Command         cmd;
+        int             net;
+        deque<int>      keys;
+};
 
-void displayHelp()
-{
-        touchwin(winHelp);
-        wrefresh(winHelp);
-        wgetch(winHelp);
-}
+FILE          *recordFile;
+bool           recordKeys;   // a command runs
+deque<Replay>  replay;       // the loaded session
+deque<int>    *replayKeys;   // of the running command
 
 //--------------------------------------------------------------------
-// Position the input window
+// All blocking key reads: live, recorded or replayed.
+// Headless there is no terminal: out of keys == Esc, to back out
 
-void positionInWin(Command cmd, short width, const char *title, short height=3)
+int getKey(WINDOW* win)
 {
-        if (wresize(winInput, height, width) != OK) {
-                exitMsg(41, "Failed to resize window.");
-        }
+        if (headless) {
+                if (! replayKeys || replayKeys->empty()) {
+                        return KEY_ESCAPE;
+                }
 
-        wbkgd(winInput, attribStyle[cInputWin]);
-        werase(winInput);
+                int key = replayKeys->front();
 
-        mvwin(winInput,
-                ((! singleFile && (cmd & cmgGotoBottom))
-                      ? ((cmd & cmgGotoTop)
-                              ? numLines                  // Moving both
-                              : numLines + numLines / 2)  // Moving bottom
-                      : (numLines - 1 ) / 2),             // Moving top
-                 (screenWidth - width) / 2);
+                replayKeys->pop_front();
 
-        box(winInput, 0, 0);
+                return key;
+        }
 
-        mvwaddstr(winInput, 0, (width - strlen(title)) / 2, title);
-}
+        if (directVT && is_wintouched(win)) {
+                refreshW(win);  // or wgetch() refreshes it, not knowing the panes
+        }
 
-//====================================================================
-// Class ConWindow  ##:win
+        int key = wgetch(win);
 
-class ConWindow
-{
-    protected:
-        WINDOW         *winW;
+        if (recordFile && recordKeys && key != ERR) {
+                fprintf(recordFile, "k %d\n", key);
+        }
 
-    public:
-        ConWindow()                                             {}
-       ~ConWindow()                                             { delwin(winW); winW = NULL; }
+        return key;
+}
 
-        void            initW(short x, short y, short width, short height, Style style);
-        void            updateW()                               { touchwin(winW); wrefresh(winW); }
-        int             readKeyW()                              { return wgetch(winW); }
+//--------------------------------------------------------------------
+// Curses on /dev/null at a fixed size, no pauses
 
-        void            put(short x, short y, const char* s)    { mvwaddstr(winW, y, x, s); }
-        void            setAttribs(Style color)                 { wattrset(winW, attribStyle[color]); }
-        void            putAttribs(short x, short y, Style color, short count);
+void goHeadless(int cols=150, int lines=40)
+{
+        setenv("COLUMNS", to_string(cols).c_str(),  1);
+        setenv("LINES",   to_string(lines).c_str(), 1);
 
-        void            setCursor(short x, short y)             { wmove(winW, y, x); }
+        headless = true;
+}
 
-}; // end ConWindow
+bool loadSession(const char* path)
+{
+        FILE *in = fopen(path, "r");
+        char  line[64];
 
-//====================================================================
-// Class ConWindow member functions
+        if (! in) {
+                return false;
+        }
 
-//--------------------------------------------------------------------
-// Initialize the window
+        while (fgets(line, sizeof(line), in)) {
+                int a, b;
 
-void ConWindow::initW(short x, short y, short width, short height, Style attrib)
-{
-        if (! (winW = newwin(height, width, y, x))) {
-                exitMsg(21, "Failed to create main window.");
+                if (sscanf(line, "s %d %d", &a, &b) == 2) {
+                        goHeadless(a, b);
+                }
+                else if (sscanf(line, "c %d %d", &a, &b) == 2) {
+                        replay.push_back({ (Command) a, b, {} });
+                }
+                else if (sscanf(line, "k %d", &a) == 1 && replay.size()) {
+                        replay.back().keys.push_back(a);
+                }
         }
 
-        wbkgd(winW, attribStyle[attrib]);
+        fclose(in);
 
-        keypad(winW, TRUE);
+        return true;
 }
 
 //--------------------------------------------------------------------
-// Change the attributes of characters in the window
+// Initialize ncurses  ##:i
 
-void ConWindow::putAttribs(short x, short y, Style color, short count)
+bool initialize()
 {
-        mvwchgat(winW, y, x, count, attribStyle[color], colorStyle[color], NULL);
-}
-
-//====================================================================
-// Class FileDisplay  ##:file
-
-class Difference;
+        setlocale(LC_ALL, "");  // for Unicode blocks
 
-class FileDisplay
-{
-    friend class Difference;
+        if (headless) {
+                FILE *null = fopen("/dev/null", "r+");
 
-        ConWindow               cwinF;
+                if (! null || ! newterm("vt100", null, null)) {
+                        return false;
+                }
+        }
+        else if (! initscr()) {
+                return false;
+        }
 
-        const Difference       *diffsF;
+        set_escdelay(10);
+        keypad(stdscr, true);
 
-        char                   *fileName;
-        File                    fd;
-        bool                    editable;
+        nonl();
+        cbreak();
+        noecho();
 
-        Byte                   *dataF;
-        int                     dataSize;
-        FPos                    offset;
-        FPos                    prevOffset;
-        FPos                    diffOffset;
-        FPos                    lastOffset;
+        if (has_colors()) {
+                start_color();
 
-        FPos                   *addr;
-        int                     se4rch;
+                init_pair(pairWhiteBlue,   COLOR_WHITE,  COLOR_BLUE);
+                init_pair(pairBlackWhite,  COLOR_BLACK,  COLOR_WHITE);
+                init_pair(pairRedWhite,    COLOR_RED,    COLOR_WHITE);
+                init_pair(pairYellowBlue,  COLOR_YELLOW, COLOR_BLUE);
+                init_pair(pairGreenBlue,   COLOR_GREEN,  COLOR_BLUE);
+                init_pair(pairBlackCyan,   COLOR_BLACK,  COLOR_CYAN);
+                init_pair(pairGreenBlack,  COLOR_GREEN,  COLOR_BLACK);
+                init_pair(pairWhiteCyan,   COLOR_WHITE,  COLOR_CYAN);
+                init_pair(pairWhiteRed,    COLOR_WHITE,  COLOR_RED);
+                init_pair(pairBlackYellow, COLOR_BLACK,  COLOR_YELLOW);
+        }
 
-    public:
-        FPos                    searchOff;
-        FPos                    scrollOff;
-        FPos                    repeatOff;
-        FPos                    startAddr;
-        Size                    filesize;
-        Size                    laptime;
-        bool                    two;
+        curs_set(0);
 
-    public:
-                FileDisplay()                           {}
-               ~FileDisplay();
+        directVT = DIRECT_RENDER && has_colors() && ! headless;
+        vtAttr   = -1;
+        vtY      = -1;
 
-        bool    setFile(char* FileName);
-        void    initF(int y, const Difference* Diff);
-        void    resizeF();
-        void    updateF()                               { cwinF.updateW(); }
-        int     readKeyF()                              { return cwinF.readKeyW(); }
+        vtShown.assign(directVT ? LINES * COLS : 0, 0);
+        vtStale.assign(directVT ? LINES : 0, 1);
 
-        void    display();
-        void    busy(bool on, bool ic);
-        void    highEdit(short count);
+        if (directVT) {
+                refresh();  // stdscr once, else the first getch() sends it over the panes
+        }
 
-        void    edit(const FileDisplay* other);
-        void    editOut(short outOffset);
-        bool    WriteTail(FPos start);
-        bool    assure();
-        void    progress1();
-        void    progress(wchar_t* bar, int count, int delay, int stint);
-        Size    finish(int init);
+        return true;
+} // end initialize
 
-        void    setLast()                               { lastOffset = offset; }
-        void    getLast()                               { FPos tmp = offset; moveTo(lastOffset); lastOffset = tmp; }
-        void    skip(bool upwards);
-        void    sync(const FileDisplay* other);
+//--------------------------------------------------------------------
+// Pause for the eye, not when headless
 
-        void    move(FPos step)                         { moveTo(offset + step); }
-        void    moveTo(FPos newOffset);
-        void    moveToEnd()                             { moveTo(filesize - steps[cmmMovePage]); }
-        void    moveForw(const Byte* searchFor, Size searchLen);
-        void    moveBack(const Byte* searchFor, Size searchLen);
+void nap(int ms)
+{
+        if (! headless) {
+                napms(ms);
 
-        void    seekNotChar(bool upwards);
-        void    smartScroll();
-}; // end FileDisplay
+                pausedNs += ms * 1000000ul;
+        }
+}
 
-//====================================================================
-// Class Difference
+//--------------------------------------------------------------------
+// Visible difference between insert and overstrike mode
 
-class Difference
+void showCursor(bool over=false)
 {
-    friend void FileDisplay::display();
+        over ? curs_set(2) : curs_set(1);
 
-    protected:
-        Byte           *dataD;
-        FileDisplay    *file1D;
-        FileDisplay    *file2D;
+#if SET_CURSOR_COLOR
+        over ? printf("\e]12;%s\a", colorDelete) : printf("\e]12;%s\a", colorInsert);
 
-    public:
-                Difference(FileDisplay* File1, FileDisplay* File2):
-                                        file1D(File1), file2D(File2)  {}
-               ~Difference()                                            { delete [] dataD; }
-        void    resizeD();
-        int     compute(Command cmd);
-        void    speedup(int way);
-}; // end Difference
+        fflush(stdout);
+#endif
+}
 
-//====================================================================
-// Object instantiation
+void hideCursor()
+{
+        curs_set(0);
+}
 
-FileDisplay     file1, file2;
+//--------------------------------------------------------------------
+// Shutdown ncurses
 
-Difference      diffs(&file1, &file2);
+void shutdown()
+{
+        delwin(winInput);
+        delwin(winHelp);
 
-//====================================================================
-// Class Difference member functions
+        showCursor();
 
-void Difference::resizeD()
-{
-        dataD = new Byte[bufSize];
+        endwin();
 }
 
 //--------------------------------------------------------------------
-// Compute differences  ##:u
+// Error exit ncurses
 
-int Difference::compute(Command cmd)
+void exitMsg(int status, const char* message)
 {
-        haveDiff = 0;
-        memset(dataD, 0, bufSize);
+        shutdown();
 
-        if (! file1D->dataSize) {
-                file1.moveToEnd();
-        }
+        errx(status, message);
+}
 
-        if (! file2D->dataSize) {
-                file2.moveToEnd();
-        }
+//--------------------------------------------------------------------
+// Reset variables for ascii mode
 
-        const Byte *buf1 = file1D->dataF,
-                   *buf2 = file2D->dataF;
+void setViewMode()
+{
+        lineWidth = modeAscii ? lineWidthAsc : lineWidthAsc / 4;
 
-        int size = min(file1D->dataSize, file2D->dataSize);
+        bufSize = numLines * lineWidth;
 
-        int diff = 0;
-        for (; diff < size; ++diff) {
-                if (*buf1++ != *buf2++) {
-                        dataD[diff] = true;
-                        haveDiff++;
-                }
-        }
+        searchIndent = lineWidth * 3;
 
-        size = max(file1D->dataSize, file2D->dataSize);
+        steps[cmmMoveByte] = 1;
+        steps[cmmMoveLine] = lineWidth;
+        steps[cmmMovePage] = bufSize - lineWidth;
+        steps[cmmMoveAll]  = 0;
+}
 
-        for (; diff < size; ++diff) {
-                dataD[diff] = true;
-                haveDiff++;
-        }
+//--------------------------------------------------------------------
+// Set variables for dynamic width  ##:y
 
-        if (cmd == cmPrevDiff && (! file1D->offset || ! file2D->offset)) {
-                return 1;
+void calcScreenLayout()
+{
+        if (COLS < minScreenWidth) {
+                string err("The screen must be at least " + to_string(minScreenWidth) + " characters wide.");
+
+                exitMsg(31, err.c_str());
         }
 
-        if (cmd == cmNextDiff && (file1D->dataSize < bufSize || file2D->dataSize < bufSize)) {
-                haveDiff = -1;  // move anyway
+        if (LINES < minScreenHeight) {
+                string err("The screen must be at least " + to_string(minScreenHeight) + " lines high.");
+
+                exitMsg(32, err.c_str());
         }
 
-        return haveDiff;
-} // end Difference::compute
+        short tera = sizeTera ? 3 : 0;  // use large addresses only if needed
+
+        leftMar = 11 + tera;
+
+        int fit = min<int>((COLS - leftMar - 1) / 4 & ~7, maxLineWidth);  // multiple of 8
+
+        lineWidth   = widthWanted && widthWanted < fit ? widthWanted : fit;
+        leftMar2    = leftMar + lineWidth * 3 + 1;
+        screenWidth = leftMar2 + lineWidth;
+
+        lineWidthAsc = lineWidth * 4;
+
+        inWidth = (sizeTera ? 15 : 11) + 1;  // sign
+
+        linesTotal = LINES;
+
+        numLines = linesTotal / panes - 1;
+
+        setViewMode();
+} // end calcScreenLayout
 
 //--------------------------------------------------------------------
-// Speedup differ - diff in next/prev staticSize bytes
+// Convert a character to uppercase
 
-void Difference::speedup(int way)
+int upCase(int c)
 {
-        if (way > 0) {
-                SeekFile(file1D->fd, file1D->offset);
-                SeekFile(file2D->fd, file2D->offset);
+        return (c >= 'a' && c <= 'z') ? c & ~0x20 : c;
+}
 
-                while (file1D->offset + staticSize < file1.filesize &&
-                                file2D->offset + staticSize < file2.filesize && ! stopRead) {
-                        ReadFile(file1D->fd, bufFile1, staticSize);
-                        ReadFile(file2D->fd, bufFile2, staticSize);
+//--------------------------------------------------------------------
+// Search kernel: first match in buf or -1  ##:scan
+//
+// TurboSearch: 8 bytes at once for the leading non-zero byte,
+// zero-tolerant.  Reads up to 7 bytes behind len.
 
-                        if (memcmp(bufFile1, bufFile2, staticSize)) {
-                                break;
-                        }
+FPos ScanForw(const Byte* buf, Size len, const Byte* searchFor, Size searchLen)
+{
+        Full leader = 0;
+        Size bias   = 0;
 
-                        file1D->offset += staticSize;
-                        file2D->offset += staticSize;
+        while (! *(searchFor + bias) && bias < searchLen) {
+                ++bias;
+        }
+
+        if (bias == searchLen) {
+                bias = 0;
+        }
+        else {
+                for (Size i=0; i < 8; ++i) {
+                        leader = leader << 8 | *(searchFor + bias);
                 }
         }
-        else {  // downwards
-                while (file1D->offset - staticSize > 0 &&
-                                file2D->offset - staticSize > 0 && ! stopRead) {
-                        SeekFile(file1D->fd, file1D->offset - staticSize);
-                        SeekFile(file2D->fd, file2D->offset - staticSize);
 
-                        ReadFile(file1D->fd, bufFile1, staticSize);
-                        ReadFile(file2D->fd, bufFile2, staticSize);
+        for (Size i=0; i <= len - searchLen; ++i) {
+                Full turbo = *(Full*) (buf + i + bias);
 
-                        if (memcmp(bufFile1, bufFile2, staticSize)) {
-                                break;
+                if (! turbo) {
+                        if (leader) {
+                                goto incr;
+                        }
+                        else {
+                                goto skip;
+                        }
+                }
+
+                turbo ^= leader;
+
+                if      (! (turbo & 0x00000000000000FF)) { i += 0; }
+                else if (! (turbo & 0x000000000000FF00)) { i += 1; }
+                else if (! (turbo & 0x0000000000FF0000)) { i += 2; }
+                else if (! (turbo & 0x00000000FF000000)) { i += 3; }
+                else if (! (turbo & 0x000000FF00000000)) { i += 4; }
+                else if (! (turbo & 0x0000FF0000000000)) { i += 5; }
+                else if (! (turbo & 0x00FF000000000000)) { i += 6; }
+                else if (! (turbo & 0xFF00000000000000)) { i += 7; }
+                else {
+incr:                   i += 7;
+cont:                   continue;
+                }
+
+skip:           if (searchFor[searchLen - 1] == buf[i + searchLen - 1]) {
+                        Size j = 0;
+                        for (; j + 7 < searchLen; j+=8) {
+                                if (*(Full*) (searchFor  + j) !=
+                                    *(Full*) (buf + i + j)) {
+                                        goto cont;
+                                }
                         }
 
-                        file1D->offset -= staticSize;
-                        file2D->offset -= staticSize;
+                        if (searchLen != j) {  // shl mask 63
+                                if ((*(Full*) (searchFor  + j) ^
+                                     *(Full*) (buf + i + j) )
+                                     << 8 * (8 - searchLen + j)) {
+                                        goto cont;
+                                }
+                        }
+
+                        if (i > len - searchLen) {  // limit turbo
+                                goto cont;
+                        }
+
+                        return i;
                 }
         }
-} // end Difference::speedup
 
-//====================================================================
-// Class FileDisplay member functions
+        return -1;
+} // end ScanForw
 
-FileDisplay::~FileDisplay()
+//--------------------------------------------------------------------
+// Vector kernels, picked at startup by the CPU  ##:simd
+//
+// One body per kernel in GCC vector extensions, inlined into thin
+// wrappers compiled for SSE2 / AVX2 / AVX-512BW.  The baseline stays
+// x86-64, so static builds run anywhere.  VBL_SIMD=generic|sse2|avx2
+// caps the choice.
+
+typedef Byte Vec16 __attribute__((vector_size(16)));
+typedef Byte Vec32 __attribute__((vector_size(32)));
+typedef Byte Vec64 __attribute__((vector_size(64)));
+
+template <typename V> struct Loose { typedef V type __attribute__((aligned(1))); };
+
+#define mInline         inline __attribute__((always_inline))
+
+#define mLoad(p)        (*(const typename Loose<V>::type*) (p))
+
+template <typename V> mInline Full vecLane(const V& v, int k)  // 8 bytes
 {
-        if (fd) {
-                close(fd);
-        }
+        Full w;
+        memcpy(&w, (const Byte*) &v + 8 * k, 8);
+        return w;
+}
 
-        delete [] dataF;
+template <typename V> mInline bool vecAny(const V& v)
+{
+        Full w = 0;
 
-        free(addr);
+        for (int k = 0; k < (int) sizeof(V) / 8; ++k) {
+                w |= vecLane(v, k);
+        }
+
+        return w;
 }
 
 //--------------------------------------------------------------------
-// Open a file for display
+// Search: first and last byte of the pattern select candidates
 
-bool FileDisplay::setFile(char* FileName)
+template <typename V> mInline
+FPos scanVec(const Byte* buf, Size len, const Byte* searchFor, Size searchLen, bool back)
 {
-        fileName = FileName;
+        const Size W = sizeof(V);
+        V first, last;
 
-        File probe = OpenFile(fileName, true);
+        memset(&first, searchFor[0], W);
+        memset(&last,  searchFor[searchLen - 1], W);
 
-        if (probe > 0) {
-                editable = true;
-                close(probe);
-        }
+        Size blocks = len - searchLen + 1 >= W ? (len - searchLen + 1) / W : 0,
+             base   = back ? len - searchLen + 1 - blocks * W : 0;  // scalar part below
 
-        if ((fd = OpenFile(fileName)) < 0) {
-                return false;
-        }
+        for (Size n = 0; n < blocks; ++n) {
+                Size at = back ? base + (blocks - 1 - n) * W : n * W;
+                V hit = (V) (mLoad(buf + at) == first) &
+                        (V) (mLoad(buf + at + searchLen - 1) == last);
 
-        if ((filesize = SeekFile(fd, 0, SEEK_END)) < 0) {
-                return false;
-        }
+                if (! vecAny(hit)) {
+                        continue;
+                }
 
-        if (filesize > 68719476736) {  // 2**30*64 == 0x10**9 == 64GB
-                sizeTera = true;
+                for (int k = 0; k < (int) W / 8; ++k) {
+                        int  lane = back ? W / 8 - 1 - k : k;
+                        Full z    = vecLane(hit, lane);
+
+                        while (z) {
+                                int  b   = back ? 7 - __builtin_clzl(z) / 8 : __builtin_ctzl(z) / 8;
+                                Size pos = at + 8 * lane + b;
+
+                                if (! memcmp(buf + pos, searchFor, searchLen)) {
+                                        return pos;
+                                }
+
+                                z &= ~(0xFFul << 8 * b);
+                        }
+                }
         }
 
-        SeekFile(fd, 0);
+        if (! back) {
+                FPos i = ScanForw(buf + blocks * W, len - blocks * W, searchFor, searchLen);
 
-        return true;
-} // end FileDisplay::setFile
+                return i < 0 ? -1 : blocks * W + i;
+        }
 
-void FileDisplay::resizeF()
-{
-        delete [] dataF;
+        for (Size pos = base; pos-- > 0;) {
+                if (! memcmp(buf + pos, searchFor, searchLen)) {
+                        return pos;
+                }
+        }
 
-        dataF = new Byte[bufSize];
+        return -1;
 }
 
 //--------------------------------------------------------------------
-// Set member variables
+// First (last) byte not equal to c, or -1
 
-void FileDisplay::initF(int y, const Difference* Diff)
+template <typename V> mInline
+FPos notByteVec(const Byte* buf, Size len, Byte c, bool back)
 {
-        diffsF = Diff;
-        two = y ? true : false;
+        const Size W = sizeof(V);
+        V f;
 
-        cwinF.initW(0, y, screenWidth, numLines + 1, cMainWin);
+        memset(&f, c, W);
 
-        resizeF();
+        Size blocks = len / W,
+             rest   = len - blocks * W;
 
-        moveTo(startAddr);
+        if (back) {
+                for (Size pos = len; pos-- > blocks * W;) {
+                        if (buf[pos] != c) {
+                                return pos;
+                        }
+                }
+        }
 
-        addr = (FPos*) calloc(numLines, sizeof(FPos));
+        for (Size n = 0; n < blocks; ++n) {
+                Size at = back ? (blocks - 1 - n) * W : n * W;
+                V    x  = mLoad(buf + at) ^ f;
+
+                if (! vecAny(x)) {
+                        continue;
+                }
+
+                for (int k = 0; k < (int) W / 8; ++k) {
+                        int  lane = back ? W / 8 - 1 - k : k;
+                        Full z    = vecLane(x, lane);
+
+                        if (z) {
+                                return at + 8 * lane + (back ? 7 - __builtin_clzl(z) / 8 : __builtin_ctzl(z) / 8);
+                        }
+                }
+        }
+
+        for (Size pos = blocks * W; ! back && pos < blocks * W + rest; ++pos) {
+                if (buf[pos] != c) {
+                        return pos;
+                }
+        }
+
+        return -1;
 }
 
 //--------------------------------------------------------------------
-// Display the file contents  ##:disp
+// Mark differing bytes with 1, count them
 
-void FileDisplay::display()
+template <typename V> mInline
+int diffVec(const Byte* a, const Byte* b, Byte* out, int len)
 {
-        if (! fd) {
-                return;
-        }
+        const int W = sizeof(V);
+        V one;
 
-        short first,
-              last,
-              row,
-              col,
-              idx,
-              lineLength;
+        memset(&one, 1, W);
+        int count = 0,
+            i     = 0;
 
-        FPos lineOffset = offset;
+        for (; i + W <= len; i += W) {
+                V d = (V) (mLoad(a + i) != mLoad(b + i)) & one;
 
-        if (scrollOff) {
-                diffOffset = scrollOff - offset;
+                memcpy(out + i, &d, W);
+
+                for (int k = 0; k < W / 8; ++k) {
+                        count += __builtin_popcountl(vecLane(d, k));
+                }
         }
-        else if (offset != prevOffset) {
-                diffOffset = offset - prevOffset;
 
-                prevOffset = offset;
+        for (; i < len; ++i) {
+                out[i] = a[i] != b[i];
+                count += out[i];
         }
 
-        Byte pos = (scrollOff ? scrollOff + lineWidth : offset + bufSize)
-                        * 100
-                        / (filesize > bufSize ? filesize : bufSize);
+        return count;
+}
 
-        char bufStat[screenWidth + 1] = { 0 };
-        memset(bufStat, ' ', screenWidth);
+//--------------------------------------------------------------------
+// ASCII to lowercase in place
 
-        char buf[96],
-             buf2[2][48];
+template <typename V> mInline
+void lowCaseVec(Byte* buf, Size len)
+{
+        const Size W = sizeof(V);
+        V lo, hi, bit;
 
-        sprintf(buf, " %s %s %d%% %s %s",
-                pretty(buf2[0], &offset, 0),
-                pretty(buf2[1], &diffOffset, 1),
-                pos > 100 ? 100 : pos,
-                ignoreCase ? "I" : "i",
-                editable ? "RW" : "RO");
+        memset(&lo,  'A' - 1, W);
+        memset(&hi,  'Z' + 1, W);
+        memset(&bit, 0x20,    W);
+        Size i = 0;
 
-        short size_name = screenWidth - strlen(buf),
-              size_fname = strlen(fileName);
+        for (; i + W <= len; i += W) {
+                V v = mLoad(buf + i);
 
-        if (size_fname <= size_name) {
-                memcpy(bufStat, fileName, size_fname);
+                v |= (V) (v > lo) & (V) (v < hi) & bit;
+                memcpy(buf + i, &v, W);
         }
-        else {
-                first = size_name / 4;
 
-                memcpy(bufStat, fileName, first);
-                memcpy(bufStat + first, " ... ", 5);
+        for (; i < len; ++i) {
+                buf[i] |= buf[i] >= 'A' && buf[i] <= 'Z' ? 0x20 : 0;
+        }
+}
 
-                last = size_name - first - 5;
+//--------------------------------------------------------------------
+// Byte histogram, four tables break the store-load chains,
+// zero blocks are only counted
 
-                memcpy(bufStat + first + 5, fileName + size_fname - last, last);
-        }
+template <typename V> mInline
+void histogramVec(const Byte* buf, Size len, Full* hist)
+{
+        const Size W = sizeof(V);
+        Half h[4][256];
+        Full zero = 0;
+        Size i = 0;
 
-        memcpy(bufStat + size_name, buf, strlen(buf));
+        memset(h, 0, sizeof(h));
 
-        cwinF.put(0, 0, bufStat);
-        cwinF.putAttribs(0, 0, cName, strlen(bufStat));
+        for (; i + 64 <= len; i += 64) {
+                V v = mLoad(buf + i);
 
-        if (lockState == lockBottom && ! two) {
-                cwinF.putAttribs(0, 0, cHighFile, size_name);
+                for (Size k = W; k < 64; k += W) {
+                        v |= mLoad(buf + i + k);
+                }
+
+                if (! vecAny(v)) {
+                        zero += 64;
+                        continue;
+                }
+
+                for (Size j = i; j < i + 64; j += 4) {
+                        ++h[0][buf[j]];
+                        ++h[1][buf[j + 1]];
+                        ++h[2][buf[j + 2]];
+                        ++h[3][buf[j + 3]];
+                }
         }
-        else if (lockState == lockTop && two) {
-                cwinF.putAttribs(0, 0, cHighFile, size_name);
+
+        for (; i < len; ++i) {
+                ++h[0][buf[i]];
         }
 
-        if (diffOffset < 0) {
-                char *pc = (char*) memchr(buf, '-', strlen(buf));
+        hist[0] += zero;
 
-                cwinF.putAttribs(size_name + (pc - buf), 0, cSearch, 1);
+        for (int b = 0; b < 256; ++b) {
+                hist[b] += h[0][b] + h[1][b] + h[2][b] + h[3][b];
         }
+}
 
-        char bufHex[screenWidth + 1] = { 0 },
-             bufAsc[  lineWidth + 1] = { 0 };
+//--------------------------------------------------------------------
+// Dispatch table
+
+struct Kernels {
+        const char *name;
+        FPos      (*scan)(const Byte* buf, Size len, const Byte* searchFor, Size searchLen, bool back);
+        FPos      (*notByte)(const Byte* buf, Size len, Byte c, bool back);
+        int       (*diff)(const Byte* a, const Byte* b, Byte* out, int len);
+        void      (*lowCase)(Byte* buf, Size len);
+        void      (*histogram)(const Byte* buf, Size len, Full* hist);
+};
 
-        for (row=0; row < numLines; ++row) {
-                memset(bufHex, ' ', screenWidth);
-                memset(bufAsc, ' ',   lineWidth);
+#define mKernels(name, isa, V) \
+        isa FPos scan_##name(const Byte* buf, Size len, const Byte* s, Size sLen, bool back) \
+                                                        { return scanVec<V>(buf, len, s, sLen, back); } \
+        isa FPos notByte_##name(const Byte* buf, Size len, Byte c, bool back) \
+                                                        { return notByteVec<V>(buf, len, c, back); } \
+        isa int  diff_##name(const Byte* a, const Byte* b, Byte* out, int len) \
+                                                        { return diffVec<V>(a, b, out, len); } \
+        isa void lowCase_##name(Byte* buf, Size len)    { lowCaseVec<V>(buf, len); } \
+        isa void histogram_##name(const Byte* buf, Size len, Full* hist) \
+                                                        { histogramVec<V>(buf, len, hist); } \
+        const Kernels kernels_##name = { #name, scan_##name, notByte_##name, diff_##name, \
+                                         lowCase_##name, histogram_##name };
+
+mKernels(generic, , Vec16)
+
+#if defined(__x86_64__)
+mKernels(sse2,   __attribute__((target("sse2"))),     Vec16)
+mKernels(avx2,   __attribute__((target("avx2"))),     Vec32)
+mKernels(avx512, __attribute__((target("avx512bw"))), Vec64)
+#endif
 
-                if (*(addr + row)) {
-                        lineOffset += (lineWidth * (*(addr + row)));
-                }
+Kernels kernel = kernels_generic;
 
-                char *pbufHex = bufHex;
+void initKernels()
+{
+        const char *cap = getenv("VBL_SIMD");
+        string      want = cap ? cap : "avx512";
 
-                pbufHex += sprintf(pbufHex, "%0*lX  ", sizeTera ? 12 : 9, lineOffset);
+#if defined(__x86_64__)
+        bool has[] = { __builtin_cpu_supports("avx512bw") != 0,
+                       __builtin_cpu_supports("avx2")     != 0,
+                       true };  // x86-64 baseline
 
-                lineLength = min(lineWidth, dataSize - row * lineWidth);
+        const Kernels *pick[] = { &kernels_avx512, &kernels_avx2, &kernels_sse2 };
 
-                for (col = idx = 0; col < lineLength; ++col, ++idx) {
-                        Byte b = dataF[row * lineWidth + col];
+        for (int k = 0, allowed = 0; k < 3; ++k) {
+                allowed |= want == pick[k]->name;
 
-                        if (! modeAscii) {
-                                pbufHex += sprintf(pbufHex, "%02X ", b);
-                        }
+                if (allowed && has[k]) {
+                        kernel = *pick[k];
+                        break;
+                }
+        }
+#endif
+} // end initKernels
 
-                        if (isgraph(b)) {
-                                bufAsc[idx] = b;
-                        }
-                        else if (isspace(b)) {
-                                bufAsc[idx] = ' ';
-                        }
-                        else {
-                                bufAsc[idx] = modeAscii ? ' ' : '.';
-                        }
-                }
-                *pbufHex = ' ';
+//--------------------------------------------------------------------
+// Convert buffer to lowercase
 
-                cwinF.put(0, row + 1, bufHex);
-                cwinF.put((modeAscii ? leftMar : leftMar2), row + 1, bufAsc);
+void lowCase(Byte* buf, Size len)
+{
+        kernel.lowCase(buf, len);
+}
 
-                for (col=0; col < (sizeTera ? 11 : 8); ++col) {
-                        if (*(bufHex + col) != '0') {
-                                break;
+//--------------------------------------------------------------------
+// Typed value search  ##:value
+//
+// Every alignment is mapped to an unsigned key that sorts like the
+// value (sign flipped for ints, IEEE bits folded for floats), so one
+// range test covers u/i/f in both byte orders.
+
+struct ValueQuery {
+        int     size;    // bytes, 0 == no value search
+        char    kind;    // 'u' 'i' 'f'
+        bool    big;     // byte order
+        Full    lo, hi;  // keys
+};
+
+ValueQuery lastValue;
+
+Full valueKey(char kind, int size, Full bits)
+{
+        int  shift = 64 - 8 * size;
+        Full sign  = 1ul << (63 - shift);
+
+        if (kind == 'i') {
+                return (Full) ((FPos) (bits << shift) >> shift) ^ 1ul << 63;
+        }
+        if (kind == 'f') {
+                return bits & sign ? ~bits & ~0ul >> shift : bits | sign;
+        }
+
+        return bits;
+}
+
+//--------------------------------------------------------------------
+// "u32be 0x1234", "i16 -5..5", "f64 3.14..3.15"
+
+bool parseValue(const char* text, ValueQuery& q)
+{
+        char *end;
+
+        while (*text == ' ') {
+                ++text;
+        }
+
+        q.kind = tolower(*text++);
+        q.size = strtol(text, &end, 10) / 8;
+        q.big  = tolower(end[0]) == 'b' && tolower(end[1]) == 'e';
+
+        if (tolower(end[0]) == 'l' || tolower(end[0]) == 'b') {
+                end += 2;
+        }
+
+        if (! strchr("uif", q.kind) || *end != ' ' || q.size < 1 || q.size > 8 || q.size & (q.size - 1) ||
+                        (q.kind == 'f' && q.size < 4)) {
+                return false;
+        }
+
+        const char *dots = strstr(end, "..");  // split first, strtod would take "1."
+
+        string bound[2] = { dots ? string(end, dots - end) : string(end), dots ? string(dots + 2) : "" };
+
+        int  shift = 64 - 8 * q.size;
+        Full lo[2],
+             hi[2];
+
+        for (int n = 0; n < (dots ? 2 : 1); ++n) {
+                const char *from = bound[n].c_str();
+                Full bits;
+                bool zero = false;
+
+                if (q.kind == 'f') {
+                        double d = strtod(from, &end);
+                        float  f = d;
+
+                        if (d != d) {
+                                return false;
                         }
+
+                        bits = 0;
+                        zero = ! d;
+                        memcpy(&bits, q.size == 4 ? (void*) &f : (void*) &d, q.size);
                 }
-                cwinF.putAttribs(col, row + 1, cAddress, (sizeTera ? 12 : 9) - col);
+                else if (q.kind == 'i') {
+                        FPos v = strtol(from, &end, 0);
+                        bits = (Full) v & ~0ul >> shift;
 
-                if (showRaster) {
-                        if (sizeTera) {
-                                cwinF.putAttribs(0, row + 1, cRaster, 1);
+                        if (v != (FPos) (bits << shift) >> shift) {
+                                return false;
                         }
-                        cwinF.putAttribs(sizeTera ? 4 : 1, row + 1, cRaster, 1);
-                        cwinF.putAttribs(sizeTera ? 8 : 5, row + 1, cRaster, 1);
                 }
+                else {
+                        while (*from == ' ') {
+                                ++from;
+                        }
 
-                if (! modeAscii && showRaster && bufHex[leftMar] != ' ') {
-                        for (col=0; col <= lineWidth - 8; col += 8) {
-                                cwinF.putAttribs(leftMar  + col * 3 - 1, row + 1, cRaster, 1);
-                                cwinF.putAttribs(leftMar2 + col        , row + 1, cRaster, 1);
+                        bits = strtoul(from, &end, 0);
+
+                        if (*from == '-' || bits > ~0ul >> shift) {
+                                return false;
                         }
                 }
 
-                if (haveDiff) {
-                        for (col=0; col < lineWidth; ++col) {
-                                if (diffsF->dataD[row * lineWidth + col]) {
-                                        cwinF.putAttribs(leftMar  + col * 3, row + 1, cDiff, 2);
-                                        cwinF.putAttribs(leftMar2 + col    , row + 1, cDiff, 1);
-                                }
-                        }
+                if (end == from) {
+                        return false;
                 }
 
-                if (se4rch && row >= (searchOff >= searchIndent ? searchIndent / lineWidth : 0)) {
-                        for (col=0; se4rch && col < lineWidth; --se4rch, ++col) {
-                                if (modeAscii) {
-                                        cwinF.putAttribs(leftMar  + col    , row + 1, cSearch, 1);
-                                }
-                                else {
-                                        cwinF.putAttribs(leftMar  + col * 3, row + 1, cSearch, 2);
-                                        cwinF.putAttribs(leftMar2 + col    , row + 1, cSearch, 1);
-                                }
-                        }
+                while (*end == ' ') {
+                        ++end;
                 }
 
-                if (*(addr + row)) {
-                        for (col=0; col < lineWidth; ++col) {
-                                if (modeAscii) {
-                                        cwinF.putAttribs(leftMar  + col    , row + 1, cDiff, 1);
-                                }
-                                else {
-                                        cwinF.putAttribs(leftMar  + col * 3, row + 1, cDiff, 2);
-                                        cwinF.putAttribs(leftMar2 + col    , row + 1, cDiff, 1);
-                                }
-                        }
+                if (*end) {
+                        return false;
                 }
 
-                lineOffset += lineWidth;
-        }
+                lo[n] = hi[n] = valueKey(q.kind, q.size, bits);
 
-        if (scrollOff) {
-                moveTo(offset);  // reload buffer
+                if (zero) {  // by value: -0.0 == 0.0, the keys are adjacent
+                        lo[n] = valueKey('f', q.size, 1ul << (8 * q.size - 1));
+                        hi[n] = valueKey('f', q.size, 0);
+                }
 
-                memset(addr, 0, numLines * sizeof(FPos));
+                lo[1] = lo[n];  // single value
+                hi[1] = hi[n];
         }
 
-        updateF();
-} // end FileDisplay::display
+        q.lo = min(lo[0], lo[1]);
+        q.hi = max(hi[0], hi[1]);
+
+        return true;
+}
 
 //--------------------------------------------------------------------
-// Busy status
+// First (last) alignment in buf whose value is in range, or -1
+//
+// Branch-free blocks of 64 alignments into a bit mask, one
+// instance per type so the loop body is straight-line code.
+// Reads up to 7 bytes behind len.
 
-void FileDisplay::busy(bool on=false, bool ic=false)
+template <char kind, bool big>
+FPos ScanValueT(const Byte* buf, Size len, const ValueQuery& q, bool back)
 {
-        if (on) {
-                cwinF.putAttribs(screenWidth - (ic ? 4 : 2),  0, cHighBusy, ic ? 1 : 2);
-                updateF();
-        }
-        else {
-                napms(150);
-                cwinF.putAttribs(screenWidth - (ic ? 4 : 2),  0, cName, ic ? 1 : 2);
+        Size last  = len - q.size,
+             shift = 64 - 8 * q.size;
+        Full mask  = ~0ul >> shift,
+             lo    = q.lo,
+             span  = q.hi - q.lo;
 
-                if (! singleFile && ! two) {
-                        updateF();
+        for (Size blocks = last < 0 ? 0 : last / 64 + 1, k = 0; k < blocks; ++k) {
+                Size base = (back ? blocks - 1 - k : k) * 64,
+                     n    = min<Size>(64, last - base + 1);
+                Full hits = 0;
+
+                for (Size j = 0; j < n; ++j) {
+                        Full v;
+                        memcpy(&v, buf + base + j, 8);
+
+                        v = big ? __builtin_bswap64(v) >> shift : v & mask;
+
+                        if (kind != 'u') {
+                                v = valueKey(kind, q.size, v);
+                        }
+
+                        hits |= (Full) (v - lo <= span) << j;
+                }
+
+                if (hits) {
+                        return base + (back ? 63 - __builtin_clzl(hits) : __builtin_ctzl(hits));
                 }
         }
-}
 
-//--------------------------------------------------------------------
-// Highlight statusbar
+        return -1;
+}
 
-void FileDisplay::highEdit(short count)
+FPos ScanValue(const Byte* buf, Size len, const ValueQuery& q, bool back)
 {
-        cwinF.putAttribs(0, 0, cHighEdit, count);
-}
+        switch (q.kind) {
+                case 'i':  return q.big ? ScanValueT<'i', true>(buf, len, q, back) : ScanValueT<'i', false>(buf, len, q, back);
+                case 'f':  return q.big ? ScanValueT<'f', true>(buf, len, q, back) : ScanValueT<'f', false>(buf, len, q, back);
+        }
+
+        return q.big ? ScanValueT<'u', true>(buf, len, q, back) : ScanValueT<'u', false>(buf, len, q, back);
+} // end ScanValue
 
 //--------------------------------------------------------------------
-// Display the edit buffer  ##:out
+// Approximate search kernel: at most k bytes differ  ##:fuzzy
+//
+// Shift-or (bitap) with one state word per mismatch count, all
+// pattern positions advance in parallel in the bits of a word.
+// Start of the first (back: last) match in buf or -1
+
+const int fuzzyMax = 7;  // mismatches, patterns up to 64 bytes
+
+int lastFuzzy;  // k of the last search, 0 == exact
 
-void FileDisplay::editOut(short outOffset)
+FPos ScanFuzzy(const Byte* buf, Size len, const Byte* searchFor, Size searchLen, int k, bool back)
 {
-        FPos lineOffset = offset + outOffset;
+        Full mask[256],
+             state[fuzzyMax + 1],
+             hit = 1ul << (searchLen - 1);
 
-        char bufHex[screenWidth + 1] = { 0 },
-             bufAsc[  lineWidth + 1] = { 0 };
+        for (int c = 0; c < 256; ++c) {
+                mask[c] = ~0ul;
+        }
 
-        for (int row=0; row < numLines; ++row) {
-                memset(bufHex, ' ', screenWidth);
-                memset(bufAsc, ' ',   lineWidth);
+        for (Size j = 0; j < searchLen; ++j) {
+                mask[searchFor[back ? searchLen - 1 - j : j]] &= ~(1ul << j);
+        }
 
-                char *pbufHex = bufHex;
+        for (int d = 0; d <= k; ++d) {
+                state[d] = ~0ul;
+        }
 
-                pbufHex += sprintf(pbufHex, "%0*lX  ", sizeTera ? 12 : 9, lineOffset);
+        for (Size n = 0; n < len; ++n) {
+                Full bits = mask[buf[back ? len - 1 - n : n]],
+                     prev = state[0];
 
-                int lineLength = min(lineWidth, (int) editBytes.size() - outOffset - row * lineWidth);
+                state[0] = state[0] << 1 | bits;
 
-                for (int col=0; col < lineLength; ++col) {
-                        Byte b = editBytes[outOffset + row * lineWidth + col];
+                for (int d = 1; d <= k; ++d) {
+                        Full cur = state[d];
 
-                        pbufHex += sprintf(pbufHex, "%02X ", b);
+                        state[d] = (cur << 1 | bits) & prev << 1;
+                        prev     = cur;
+                }
 
-                        bufAsc[col] = isprint(b) ? b : '.';
+                if (! (state[k] & hit)) {
+                        return back ? len - 1 - n : n - searchLen + 1;
                 }
-                *pbufHex = ' ';
+        }
 
-                cwinF.put(0,        row + 1, bufHex);
-                cwinF.put(leftMar2, row + 1, bufAsc);
+        return -1;
+} // end ScanFuzzy
 
-                if (showRaster) {
-                        int col[] = { 0, 1, 4, 5, 8 };
+//--------------------------------------------------------------------
+// Bit-shifted / XOR search kernel  ##:bits
+//
+// A single-byte XOR key cancels in the XOR of neighbouring bytes, and
+// shifting the bits shifts those differences alike, so under XOR the
+// differences of the pattern are searched.  One big-endian 64-bit
+// window of a position holds all 8 bit offsets.
+// how returns bit shift << 8 | XOR key.  Reads up to 7 bytes behind len.
 
-                        for (int i = sizeTera ? 0 : 1; i < 5; i += 2) {
-                                cwinF.putAttribs(col[i], row + 1, cRaster, 1);
-                        }
-                }
+const int bitsShift = 1,  // all 8 bit offsets
+          bitsXor   = 2;  // all 256 single-byte keys
 
-                if (showRaster && bufHex[leftMar] != ' ') {
-                        for (int col=0; col <= lineWidth - 8; col += 8) {
-                                cwinF.putAttribs(leftMar  + col * 3 - 1, row + 1, cRaster, 1);
-                                cwinF.putAttribs(leftMar2 + col        , row + 1, cRaster, 1);
-                        }
-                }
+int lastBits;  // mode of the last search, 0 == plain
 
-                for (int c, col=0; col < lineLength; ++col) {
-                        if ((c = editColor[outOffset + row * lineWidth + col])) {
-                                cwinF.putAttribs(leftMar  + col * 3, row + 1, (Style) c, 2);
-                                cwinF.putAttribs(leftMar2 + col    , row + 1, (Style) c, 1);
-                        }
-                }
+FPos ScanBits(const Byte* buf, Size len, const Byte* searchFor, Size searchLen, int mode, bool back, int& how)
+{
+        bool xr     = mode & bitsXor;
+        int  shifts = mode & bitsShift ? 8 : 1;
+        Size tLen   = searchLen - xr;
+        Byte target[searchLen];
 
-                lineOffset += lineWidth;
+        for (Size j = 0; j < tLen; ++j) {
+                target[j] = xr ? searchFor[j] ^ searchFor[j + 1] : searchFor[j];
         }
-} // end FileDisplay::editOut
 
-//--------------------------------------------------------------------
-// Obtain confirmation for lengthy write
+        Full lead = (Full) target[0] << 8 | target[1];
 
-bool FileDisplay::assure()
-{
-        bool ret = true;
-        Size diff = filesize - offset;
+        auto at = [&](Size p, int sh) {  // byte p of the (difference) stream, shifted
+                int b = xr ? buf[p] ^ buf[p + 1]         : buf[p],
+                    c = xr ? buf[p + 1] ^ buf[p + 2]     : buf[p + 1];
 
-        if (diff > warnResize) {
-                char str[96],
-                     inp[4];
+                return (Byte) (b << sh | c >> (8 - sh));
+        };
 
-                sprintf(str, " About to write *non-interruptable* %.1fGB!? {yes|no}: ", (double) diff / 1073741824);
+        Size last = len - searchLen;
 
-                echo();
-                for (;;) {
-                        positionInWin(two ? cmgGotoBottom : cmgGotoTop, 1+ strlen(str) +5+1, " Attention! ", 5);
+        if (back && shifts > 1) {  // any shift ends one byte early, as the window of moveScan
+                --last;            // does: the hit it ends at is not found again
+        }
 
-                        mvwaddstr(winInput, 2, 1, str);
+        for (Size n = 0; n <= last; ++n) {
+                Size i = back ? last - n : n;
+                Full w = __builtin_bswap64(*(const Full*) (buf + i));
 
-                        wgetnstr(winInput, inp, 3);
+                if (xr) {
+                        w ^= w << 8;
+                }
 
-                        if (! strcmp(inp, "yes")) {
-                                break;
+                for (int sh = 0; sh < shifts; ++sh) {
+                        if ((w << sh) >> 48 != lead || (sh && i + searchLen + 1 > len)) {
+                                continue;
                         }
 
-                        else if (! strcmp(inp, "no")) {
-                                ret = false;
-                                break;
+                        Size j = 2;
+
+                        while (j < tLen && at(i + j, sh) == target[j]) {
+                                ++j;
+                        }
+
+                        if (j == tLen) {
+                                how = sh << 8 | (Byte) ((buf[i] << sh | buf[i + 1] >> (8 - sh)) ^ searchFor[0]);
+                                return i;
                         }
                 }
-                noecho();
         }
-        updateF();
-        hideCursor();
 
-        return ret;
-} // end FileDisplay::assure
+        return -1;
+} // end ScanBits
 
 //--------------------------------------------------------------------
-// Progress bar single
+// Lookup tables for the display  ##:lut
 
-void FileDisplay::progress1()
-{
-        int blocks = 25,
-            delay  = 4;
-
-        hideCursor();
-        positionInWin(two ? cmgGotoBottom : cmgGotoTop, 2+ blocks +2, "");
-
-        wchar_t bar[blocks + 1];
-        memset(bar, 0, sizeof(bar));
+char hexLUT[256][3],  // "XX "
+     ascLUT[2][256];  // ascii column, [1] ascii mode
 
-        for (int i=0; i < blocks; ++i) {
-                for (int j=0; j < 8; ++j) {
-                        bar[i] = barSyms[j];
+void initLUT()
+{
+        for (int b=0; b < 256; ++b) {
+                hexLUT[b][0] = hexDigits[b >> 4];
+                hexLUT[b][1] = hexDigits[b & 0x0F];
+                hexLUT[b][2] = ' ';
 
-                        mvwaddwstr(winInput, 1, 2, bar);
-                        wrefresh(winInput);
-                        napms(delay);
+                for (int mode=0; mode < 2; ++mode) {
+                        if (isgraph(b)) {
+                                ascLUT[mode][b] = b;
+                        }
+                        else if (isspace(b)) {
+                                ascLUT[mode][b] = ' ';
+                        }
+                        else {
+                                ascLUT[mode][b] = mode ? ' ' : '.';
+                        }
                 }
         }
-        napms(250);
 }
 
 //--------------------------------------------------------------------
-// Progress bar multiple
+// Attribute span of a row, clipped
 
-void FileDisplay::progress(wchar_t* bar, int count, int delay, int stint=1)
+void paint(Style* attr, short x, Style color, short count)
 {
-        int pos = count * stint / 8,
-            sym = count * stint % 8;
-
-        for (int i=0; i < stint; ++i) {
-                bar[pos] = barSyms[sym % 8];
-
-                if (! (++sym % 8)) {
-                        ++pos;
-                }
-
-                mvwaddwstr(winInput, 1, 2, bar);
-                wrefresh(winInput);
-
-                if (delay) {
-                        napms(delay);
-                }
+        for (int end = min(x + count, screenWidth); x < end; ++x) {
+                attr[x] = color;
         }
 }
 
 //--------------------------------------------------------------------
-// Progress bar end (or debug profiling)
+// Convert hex string to bytes
 
-Size FileDisplay::finish(int init=0)
+int packHex(char* buf)
 {
-        timespec ts;
+        Byte *pb = (Byte*) buf,
+             *po = pb;
 
-        clock_gettime(CLOCK_TAI, &ts);
+        for (Byte b; (b = *pb); ++pb) {
+                if (b == ' ') {
+                        continue;
+                }
+                else {
+                        b = (b - (*pb++ > 64 ? 55 : 48)) << 4;
 
-        if (init) {
-                laptime = ts.tv_sec * 1000000000 + ts.tv_nsec;
+                        b |= *pb - (*pb > 0x40 ? 0x37 : 0x30);
 
-                return 0;
+                        *po++ = b;
+                }
         }
 
-        return (ts.tv_sec * 1000000000 + ts.tv_nsec - laptime);
+        return po - (Byte*) buf;
 }
 
 //--------------------------------------------------------------------
-// Append the remainder
+// My pretty printer
 
-bool FileDisplay::WriteTail(FPos start)
+char *pretty(char *buffer, FPos *size, int sign)
 {
-        bool insert = start > 0 ? true : false;
+        char aBuf[64],
+             *pa = aBuf,
+             *pb = buffer;
 
-        FPos srcOff = offset + dataSize,
-             dstOff = offset + start * (insert ? 1 : -1);
-        Size remain = filesize - srcOff;
+        sprintf(aBuf, (sign ? "%+ld" : "%ld"), *size);
 
-        int width = (screenWidth - 4) * 8,
-            level = (screenWidth / 3) * 8,
-            cargo = staticSize,
-            loops = remain / cargo,
-            scale = 0,
-            delay = 4,
-            count = 0,
-            stage = 0,
-            tally = 0,
-            final = 0;
+        int len = strlen(aBuf);
 
-        Size round = 0,
-             chunk = 0;
+        while (len) {
+                *pb++ = *pa++;
 
-        if (! loops) {
-                progress1();
+                if (sign) {
+                        --sign;
+                        --len;
+                }
+                else {
+                        if (--len && ! (len % 3)) {
+                                if (thouSep) {
+                                        *pb++ = thouSep;
+                                }
+                        }
+                }
         }
+        *pb = 0;
 
-        else if (loops > width) {
-                scale = loops / width + (loops % width ? 1 : 0);
-                width = loops / scale + (loops % scale ? 1 : 0);
+        return buffer;
+} // end pretty
+
+//--------------------------------------------------------------------
+// Help window
+
+void fillHelp(int page)
+{
+        werase(winHelp);
+        box(winHelp, 0, 0);
+
+        char title[32];
+        sprintf(title, " Help %d/%d ", page + 1, helpPages);
+
+        mvwaddstr(winHelp, 0,              (helpWidth - strlen(title))       / 2, title);
+        mvwaddstr(winHelp, helpHeight - 1, (helpWidth - strlen(helpVersion)) / 2, helpVersion);
+
+        for (int i=0; i < helpHeight - 2; ++i) {  // exclude border
+                mvwaddstr(winHelp, i + 1, 1, aHelpPage[page][i]);
         }
 
-        else if (loops > level) {
-                width = loops;
+        for (const Byte *b = aBoldPage[page]; *b; b += 2) {
+                mvwchgat(winHelp, b[0], b[1], 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
         }
+}
 
-        else {
-                cargo = remain / level >> 12;
-                cargo *= 4096;  // page align
+void displayHelp()
+{
+        for (int page=0; page < helpPages; ++page) {
+                fillHelp(page);
 
-                width = remain / cargo;
+                touchwin(winHelp);
+                refreshW(winHelp);
+
+                if (getKey(winHelp) == KEY_ESCAPE) {
+                        break;
+                }
         }
+}
 
-        stage = width - 8;
+//--------------------------------------------------------------------
+// Position the input window
 
-        width = width / 8 + (width % 8 ? 1 : 0);
+void positionInWin(Command cmd, short width, const char *title, short height=3)
+{
+        if (wresize(winInput, height, width) != OK) {
+                exitMsg(41, "Failed to resize window.");
+        }
 
-        wchar_t bar[width + 1];
-        memset(bar, 0, sizeof(bar));
+        wbkgd(winInput, attribStyle[cInputWin]);
+        werase(winInput);
 
-        if (loops) {
-                positionInWin(two ? cmgGotoBottom : cmgGotoTop, 2+ width +2, "");
-        }
+        mvwin(winInput,
+                ((! singleFile && (cmd & cmgGotoBottom))
+                      ? ((cmd & cmgGotoTop)
+                              ? numLines                  // Moving both
+                              : numLines + numLines / 2)  // Moving bottom
+                      : (numLines - 1 ) / 2              // Moving top
+                        + ((cmd & cmgGotoTop || ! viewFocus)
+                              ? 0
+                              : (numLines + 1) * ((singleFile ? 1 : 2) + viewFocus - 1))),  // Moving a view
+                 (screenWidth - width) / 2);
 
-#if SHOW_WRITE_SUMMARY
-        int term = time(NULL);
-#endif
-        if (remain >= cargo) {
-                if (insert) {
-                        srcOff = filesize;  // downwards
-                        dstOff = filesize + start - dataSize;
-                }
+        box(winInput, 0, 0);
 
-                while (remain >= cargo) {
-                        if (mScale > stage) {  // use only the last ones for timekeeping
-                                finish(1);
-                        }
+        mvwaddstr(winInput, 0, (width - strlen(title)) / 2, title);
+}
 
-                        if (insert) {
-                                srcOff -= cargo;
-                        }
-                        SeekFile(fd, srcOff);
-                        ReadFile(fd, buffer, cargo);
+//====================================================================
+// Class ConWindow  ##:win
 
-                        if (insert) {
-                                dstOff -= cargo;
-                        }
-                        else {
-                                srcOff += cargo;
-                        }
+class ConWindow
+{
+    protected:
+        WINDOW         *winW;
 
-                        SeekFile(fd, dstOff);
-                        if (! WriteFile(fd, buffer, cargo)) {
-                                return false;
-                        }
-                        if (! insert) {
-                                dstOff += cargo;
-                        }
+    public:
+        ConWindow()                                             {}
+       ~ConWindow()                                             { delwin(winW); winW = NULL; }
 
-                        remain -= cargo;
+        void            initW(short x, short y, short width, short height, Style style);
+        void            updateW();
+        int             readKeyW()                              { return getKey(winW); }
+        int             peekKeyW();
 
-                        if (mScale > stage) {
-                                round += finish() + 1;  // assure non-zero
-                        }
+        void            put(short x, short y, const char* s)    { mvwaddstr(winW, y, x, s); }
+        void            putLine(short y, const chtype* s, short n) { mvwaddchnstr(winW, y, 0, s, n); }
+        void            scrollW(short top, short bottom, short n);
+        void            resizeW(short width, short height)      { wresize(winW, height, width); }
+        void            placeW(short y, short width, short height);
+        void            setAttribs(Style color)                 { wattrset(winW, attribStyle[color]); }
+        void            putAttribs(short x, short y, Style color, short count);
 
-                        if (scale && count % scale) {
-                                count++;
-                                continue;
-                        }
+        void            setCursor(short x, short y)             { wmove(winW, y, x); }
 
-                        if (round) {
-                                if (! scale || tally++) {  // discard single round
-                                        chunk += round;
-                                        final++;
-                                }
+}; // end ConWindow
 
-                                round = 0;
-                        }
+//====================================================================
+// Class ConWindow member functions
 
-                        progress(bar, mScaleInc, delay);
-                }
+//--------------------------------------------------------------------
+// Initialize the window
 
-                if (insert) {
-                        srcOff -= remain;
-                        dstOff -= remain;
-                }
+void ConWindow::initW(short x, short y, short width, short height, Style attrib)
+{
+        if (! (winW = newwin(height, width, y, x))) {
+                exitMsg(21, "Failed to create main window.");
         }
 
-        if (remain > 0) {
-                SeekFile(fd, srcOff);
-                ReadFile(fd, buffer, remain);
+        wbkgd(winW, attribStyle[attrib]);
 
-                SeekFile(fd, dstOff);
-                if (! WriteFile(fd, buffer, remain)) {
-                        return false;
-                }
-        }
+        keypad(winW, TRUE);
+        idlok(winW, ! directVT);  // scroll regions for line moves
+}
 
-        if (! insert && ftruncate(fd, dstOff + remain) == ERR) {
-                return false;
+//--------------------------------------------------------------------
+// Refresh the window, direct output sends the rows below the status
+// line itself and keeps them out of the refresh of ncurses
+
+void ConWindow::updateW()
+{
+        if (! directVT) {
+                touchwin(winW);
+                wrefresh(winW);
+                return;
         }
 
-#if SHOW_WRITE_SUMMARY
-        if (filesize - offset > warnResize) {
-                term = time(NULL) - term;
+        short top  = getbegy(winW),
+              rows = min(getmaxy(winW), LINES - top),
+              cols = min(getmaxx(winW), COLS),
+              cy, cx;
 
-                sprintf(bufTimer, "  %dsec (%.1fmin)  %ldMByte/s  ",
-                        term,
-                        (float) term / 60,
-                        (filesize - offset) / 1048576 / (term ? term : 1));
+        for (short y = 1; y < rows; ++y) {  // changed since the last refresh, before the touch
+                vtStale[top + y] |= is_linetouched(winW, y);
         }
-#endif
-        if (loops) {
-                for (;;) {
-                        if (scale && count % scale) {
-                                ++count;
-                        }
 
-                        else if (mScale % 8) {  // neat finish
-                                progress(bar, mScaleInc, chunk / final / 1000000 + delay);
-                        }
+        touchwin(winW);
+        wtouchln(winW, 1, getmaxy(winW) - 1, 0);
+        wrefresh(winW);  // the first one clears the screen
 
-                        else {
-                                break;
-                        }
+        chtype line[cols + 1];
+
+        getyx(winW, cy, cx);  // the edit cursor
+
+        for (short y = 1; y < rows; ++y) {
+                if (vtStale[top + y]) {
+                        mvwinchnstr(winW, y, 0, line, cols);
+                        vtLine(top + y, line, cols);
                 }
-                napms(600);
         }
 
-        return true;
-} // end FileDisplay::WriteTail
+        wmove(winW, cy, cx);
+
+        flushVT();
+}
 
 //--------------------------------------------------------------------
-// Edit the file  ##:edit
+// Move and resize the window, in the order that stays on screen
 
-void FileDisplay::edit(const FileDisplay* other)
+void ConWindow::placeW(short y, short width, short height)
 {
-        if (! editable) {
-                return;
+        if (height > getmaxy(winW)) {
+                mvwin(winW, y, 0);
+                wresize(winW, height, width);
+        }
+        else {
+                wresize(winW, height, width);
+                mvwin(winW, y, 0);
         }
+}
 
-        bool hiNib   = true,
-             ascii   = false,
-             changed = false;
+//--------------------------------------------------------------------
+// Pending key or ERR, never waits
 
-        short x = 0,
-              y = 0,
-              outOffset;
+int ConWindow::peekKeyW()
+{
+        wtimeout(winW, 0);
 
-        int cur,
-            endY,
-            endX,
-            key;
+        int key = wgetch(winW);
 
-        editBytes.clear();
-        editColor.clear();
+        wtimeout(winW, -1);
 
-        for (int i=0; i < dataSize; ++i) {
-                editBytes.push_back(dataF[i]);
-                editColor.push_back(0);
-        }
+        return key;
+}
 
-        cwinF.setCursor(leftMar, 1);
-        showCursor();
+//--------------------------------------------------------------------
+// Scroll lines top..bottom, the terminal does it with a scroll region
 
-        for (;;) {
-                endY = editBytes.size() ? (editBytes.size() - 1) / lineWidth : 0;
-                endX = editBytes.size() ? (editBytes.size() - 1) % lineWidth : 0;
+void ConWindow::scrollW(short top, short bottom, short n)
+{
+        wsetscrreg(winW, top, bottom);
+        scrollok(winW, TRUE);
 
-                if (y > endY) {
-                        y = endY;
-                        x = endX;
-                }
+        wscrl(winW, n);
 
-                if (y == endY && x > endX) {
-                        x = endX;
-                }
+        scrollok(winW, FALSE);
 
-                cur = y * lineWidth + x;
+        if (directVT) {
+                vtScroll(getbegy(winW) + top, getbegy(winW) + bottom, n);
+        }
+}
 
-                outOffset = cur >= bufSize ? (cur - bufSize) / lineWidth + 1 : 0;
+//--------------------------------------------------------------------
+// Change the attributes of characters in the window
 
-                editOut(outOffset * lineWidth);
+void ConWindow::putAttribs(short x, short y, Style color, short count)
+{
+        mvwchgat(winW, y, x, count, attribStyle[color], colorStyle[color], NULL);
+}
 
-                cwinF.setCursor((ascii ? leftMar2 + x : leftMar + 3 * x + ! hiNib), y - outOffset + 1);
+//====================================================================
+// Class Journal  ##:jrnl
+//
+// A write is a plan of steps: moves inside the file, then patches.
+// Plan, rollback data and progress live in a sidecar file until done.
+
+const Full      stepMove  = 1,  // shift bytes inside the file
+                stepPatch = 2,  // write bytes kept in the journal
+                stepFill  = 3,  // repeat a pattern kept in the journal
+                stepCopy  = 4;  // copy from the other file
+
+const char      jrnlMagic[] = "VBLJRNL3";
+
+struct JournalStep {
+        FPos    src;   // move, copy: file offset, patch, fill: offset in patch data
+        FPos    dst;
+        Size    len;
+        Full    kind;
+        Size    arg;   // fill: pattern length
+};
 
-                key = readKeyF();
+struct JournalHead {
+        char    magic[8];
+        Size    origSize;
+        Size    newSize;
+        Size    steps;     // plan
+        Size    undos;     // rollback patches behind the plan
+        Size    patchLen;
+        Full    reverse;   // plan is a rollback
+        Full    lossy;     // dropped bytes not saved, no rollback
+        Size    otherLen;  // path of the copy source behind the patch data
+};
 
-                switch (key) {
-                        case KEY_ESCAPE:
-                                goto done;
+struct JournalMark {
+        Full    seq;
+        Size    step;
+        Size    done;
+        Size    pending;   // move bytes in flight, what they overwrite is saved behind the mark
+        Full    check;
+};
 
-                        case KEY_TAB:
-                                hiNib  = true;
-                                ascii ^= true;
-                                break;
+typedef deque<JournalStep> StepDeq;
 
-                        case KEY_IC:
-                                changed = true;
+class Journal
+{
+        string          path;
+        File            jfd = -1;
+        Full            seq = 0;
+        FPos            slots = 0;  // journal offset of the two mark slots
 
-                                editBytes.insert(editBytes.begin() + cur, ascii ? ' ' : '\0');
-                                editColor.insert(editColor.begin() + cur, cInsert);
-                                break;
+        Full    checksum(const JournalMark& m);
+        FPos    slot(Full n)    { return slots + (n & 1) * (4096 + jrnlGroup); }
 
-                        case KEY_DC:
-                                if (editBytes.size()) {
-                                        changed = true;
+    public:
+        StepDeq         plan,
+                        undos;
+        string          patch;      // data of all patch steps
+        Size            origSize = 0,
+                        newSize  = 0,
+                        step     = 0,
+                        done     = 0,
+                        pending  = 0,
+                        marked   = 0;  // done at the last mark
+        time_t          markTime = 0;
+        bool            stopped  = false,
+                        reverse  = false,
+                        lossy    = false;
+        string          other;      // copy source
+        File            ofd = -1;
+
+                Journal(const char* FileName);
+               ~Journal()                               { if (jfd >= 0) close(jfd); if (ofd >= 0) close(ofd); }
+
+        void    move(FPos src, FPos dst, Size len);
+        void    write(FPos dst, const Byte* buf, Size len, bool undo=false);
+        void    fill(FPos dst, Size len, const string& pat);
+        void    copy(FPos src, FPos dst, Size len);
+
+        bool    create();
+        bool    direct();
+        bool    load();
+        bool    mark(File fd, Size len=0);
+        bool    keep(File fd, Size len);
+        bool    settle(File fd);
+        bool    rollback(File fd);
+        Size    remain();
+        void    remove();
+}; // end Journal
 
-                                        editBytes.erase(editBytes.begin() + cur);
-                                        editColor.erase(editColor.begin() + cur);
-                                }
-                                break;
+//====================================================================
+// Class Journal member functions
 
-                        case KEY_HOME:
-                                y = x = 0;
-                                break;
+//--------------------------------------------------------------------
+// Sidecar next to regular files, devices in /var/tmp
 
-                        case KEY_END:
-                                y = endY;
-                                x = endX;
-                                break;
+Journal::Journal(const char* FileName)
+{
+        struct stat st;
 
-                        case KEY_LEFT:
-                                if (! hiNib) {
-                                        hiNib = true;
-                                        break;
-                                }
+        if (stat(FileName, &st) == OK && S_ISREG(st.st_mode)) {
+                path = string(FileName) + ".vbl-journal";
+        }
+        else {
+                path = FileName;
 
-                                else {
-                                        if (! ascii) {
-                                                hiNib = false;
-                                        }
+                for (auto &c : path) {
+                        if (c == '/') {
+                                c = '_';
+                        }
+                }
 
-                                        if (--x < 0) {
-                                                x = y ? lineWidth - 1 : endX;
-                                        }
-                                        else {
-                                                break;
-                                        }
-                                }  // fall thru
+                path = "/var/tmp/vbl" + path + ".journal";
+        }
+}
 
-                        case KEY_UP:
-                                if (--y < 0) {
-                                        y = endY;
+Full Journal::checksum(const JournalMark& m)
+{
+        Full h = 0xCBF29CE484222325;  // FNV-1a
 
-                                        if (x > endX) {
-                                                --y;
-                                        }
-                                }
-                                break;
+        for (const Byte* p = (const Byte*) &m; p < (const Byte*) &m.check; ++p) {
+                h = (h ^ *p) * 0x100000001B3;
+        }
 
-                        default: {
-                                short newByte = -1;
+        return h;
+}
 
-                                if (key == KEY_RETURN && other && other->dataSize > (cur - outOffset * lineWidth)) {
-                                        newByte = other->dataF[cur - outOffset * lineWidth];
+//--------------------------------------------------------------------
+// Add steps to the plan (moves first, then patches)
 
-                                        hiNib = false;  // advance
-                                }
+void Journal::move(FPos src, FPos dst, Size len)
+{
+        if (len > 0 && src != dst) {
+                plan.push_back({ src, dst, len, stepMove, 0 });
+        }
+}
 
-                                else if (ascii && isprint(key)) {
-                                        newByte = key;
-                                }
+void Journal::write(FPos dst, const Byte* buf, Size len, bool undo)
+{
+        if (len > 0) {
+                (undo ? undos : plan).push_back({ (FPos) patch.size(), dst, len, stepPatch, 0 });
 
-                                else {
-                                        if (isxdigit(key)) {
-                                                newByte = upCase(key) - (isdigit(key) ? 48 : 55);
+                patch.append((const char*) buf, len);
+        }
+}
 
-                                                if (hiNib) {
-                                                        newByte <<= 4;
-                                                }
+void Journal::fill(FPos dst, Size len, const string& pat)
+{
+        if (len > 0) {
+                plan.push_back({ (FPos) patch.size(), dst, len, stepFill, (Size) pat.size() });
 
-                                                newByte |= editBytes[cur] & (hiNib ? 0x0F : 0xF0);
-                                        }
-                                }
+                patch += pat;
+        }
+}
 
-                                if (newByte < 0) {
-                                        break;
-                                }
-
-                                changed = true;
+void Journal::copy(FPos src, FPos dst, Size len)
+{
+        if (len > 0) {
+                plan.push_back({ src, dst, len, stepCopy, 0 });
+        }
+}
 
-                                editBytes[cur] = newByte;
+//--------------------------------------------------------------------
+// Bytes left to write
 
-                                editColor[cur] = (cur < dataSize && dataF[cur] == newByte) ? 0 : cEdit;
-                        }  // fall thru
+Size Journal::remain()
+{
+        Size sum = 0;
 
-                        case KEY_RIGHT:
-                                if (hiNib && ! ascii) {
-                                        hiNib = false;
-                                        break;
-                                }
+        for (Size i = step; i < (Size) plan.size(); ++i) {
+                sum += plan[i].len;
+        }
 
-                                hiNib = true;
+        return sum - done;
+}
 
-                                if (++x == lineWidth) {
-                                        x = 0;
-                                }
+//--------------------------------------------------------------------
+// Write the journal (tmp + rename, never a half journal)
 
-                                if (y == endY && x > endX) {
-                                        x = 0;
-                                }
+bool Journal::create()
+{
+        step = done = pending = marked = 0;
 
-                                if (x) {
-                                        break;
-                                }  // fall thru
+        if (! WRITE_JOURNAL) {
+                return true;
+        }
 
-                        case KEY_DOWN:
-                                if (++y > endY) {
-                                        y = 0;
-                                }
+        string tmp = path + ".tmp";
 
-                                if (y == endY && x > endX) {
-                                        y = 0;
-                                }
-                }
+        if (jfd >= 0) {
+                close(jfd);
         }
 
-done:
-        if (changed) {
-                changed = false;
+        if ((jfd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600)) < 0) {
+                return false;
+        }
 
-                int size = editBytes.size();
-                Byte buf[size];
+        JournalHead head = { {0}, origSize, newSize, (Size) plan.size(), (Size) undos.size(), (Size) patch.size(),
+                             reverse, lossy, (Size) other.size() };
+        memcpy(head.magic, jrnlMagic, 8);
 
-                for (int i=0; i < size; ++i) {
-                        buf[i] = editBytes[i];
-                }
+        string out((const char*) &head, sizeof(head));
 
-                if (size == dataSize) {
-                        if (! memcmp(buf, dataF, size)) {
-                                goto done;
-                        }
-                }
+        for (auto &st : plan) {
+                out.append((const char*) &st, sizeof(st));
+        }
 
-                if (! sizeTera && filesize + size - dataSize > 68719476736) {  // very special case
-                        hideCursor();
-                        positionInWin(two ? cmgGotoBottom : cmgGotoTop, 1+ 14 +1, "", 5);
+        for (auto &st : undos) {
+                out.append((const char*) &st, sizeof(st));
+        }
 
-                        mvwaddstr(winInput, 2, 1, "  File >64GB  ");
-                        wgetch(winInput);
-                        goto done;
-                }
+        out += patch;
+        out += other;
 
-                positionInWin(two ? cmgGotoBottom : cmgGotoTop, 1+ 19 +3+1, "");
+        slots = (out.size() + 4095) & ~4095;
+        seq   = 0;
 
-                mvwaddstr(winInput, 1, 1, " Save changes [y]: ");
+        if (! WriteFile(jfd, (const Byte*) out.data(), out.size()) ||
+            ! mark(-1) || fsync(jfd) == ERR || rename(tmp.c_str(), path.c_str()) == ERR) {
+                close(jfd);
+                jfd = -1;
+                unlink(tmp.c_str());
 
-                key = wgetch(winInput);
+                return false;
+        }
 
-                if (upCase(key) != 'Y') {
-                        goto done;
-                }
+        SyncDir(path);
 
-                wechochar(winInput, key);
-                napms(500);
+        return true;
+} // end Journal::create
 
-                bool ret = false;
+//--------------------------------------------------------------------
+// No sidecar possible (read-only directory, disk full): write without,
+// as before the journal, no rollback
 
-                close(fd);
-                fd = OpenFile(fileName, true);
+bool Journal::direct()
+{
+        step = done = pending = marked = 0;
 
-                SeekFile(fd, offset);
+        lossy = true;
 
-                if (size == dataSize) {
-                        ret = WriteFile(fd, buf, dataSize);
+        return true;
+}
 
-                        progress1();
-                }
+//--------------------------------------------------------------------
+// Read an existing journal
 
-                else if (size < dataSize) {
-                        if (assure()) {
-                                if (WriteFile(fd, buf, size)) {
-                                        ret = WriteTail(size * -1);
-                                }
-                        }
-                }
+bool Journal::load()
+{
+        JournalHead head;
 
-                else {  // size > dataSize
-                        if (assure()) {
-                                SeekFile(fd, 0, SEEK_END);
+        if ((jfd = open(path.c_str(), O_RDWR)) < 0) {
+                return false;
+        }
 
-                                if (WriteFile(fd, buffer, size - dataSize)) {  // check
-                                        if (WriteTail(size)) {
-                                                SeekFile(fd, offset);
+        if (ReadAt(jfd, &head, sizeof(head), 0) != sizeof(head) || memcmp(head.magic, jrnlMagic, 8)) {
+                return false;
+        }
 
-                                                ret = WriteFile(fd, buf, size);
-                                        }
-                                }
-                        }
-                }
+        origSize = head.origSize;
+        newSize  = head.newSize;
+        reverse  = head.reverse;
+        lossy    = head.lossy;
 
-                if (ret) {
-                        if (fsync(fd) == OK) {
-                                if (close(fd) == ERR) {  // seamless error tracking
-                                        ret = false;
-                                }
+        FPos pos = sizeof(head);
 
-                                fd = -1;
-                        }
-                        else {
-                                ret = false;
-                        }
-                }
+        for (Size i=0; i < head.steps + head.undos; ++i, pos += sizeof(JournalStep)) {
+                JournalStep st;
 
-                if (fd > 0) {
-                        close(fd);
+                if (ReadAt(jfd, &st, sizeof(st), pos) != sizeof(st)) {
+                        return false;
                 }
 
-                fd = OpenFile(fileName);
-
-                filesize = SeekFile(fd, 0, SEEK_END);
+                (i < head.steps ? plan : undos).push_back(st);
+        }
 
-                move(0);
+        patch.resize(head.patchLen);
 
-                updateF();
+        if (ReadAt(jfd, &patch[0], head.patchLen, pos) != head.patchLen) {
+                return false;
+        }
 
-                if (ret) {
-                        positionInWin(two ? cmgGotoBottom : cmgGotoTop,
-                                1+ (*bufTimer ? strlen(bufTimer) : 11) +1, "", *bufTimer ? 7 : 5);
+        pos += head.patchLen;
 
-                        mvwaddstr(winInput, 2, *bufTimer ? (strlen(bufTimer) - 11) / 2 + 1 : 1, "  Success  ");
+        other.resize(head.otherLen);
 
-                        if (*bufTimer) {
-                                mvwaddstr(winInput, 4, 1, bufTimer);
-                                wgetch(winInput);
+        if (ReadAt(jfd, &other[0], head.otherLen, pos) != head.otherLen) {
+                return false;
+        }
 
-                                *bufTimer = 0;
-                        }
-                        else {
-                                wrefresh(winInput);
-                                napms(900);
-                        }
-                }
+        slots = (pos + head.otherLen + 4095) & ~4095;
 
-                else {
-                        positionInWin(two ? cmgGotoBottom : cmgGotoTop, 1+ 11 +1, "", 5);
+        for (Full n=0; n < 2; ++n) {  // the newer valid one
+                JournalMark m;
 
-                        mvwaddstr(winInput, 2, 1, "  Failed!  ");
-                        wgetch(winInput);
+                if (ReadAt(jfd, &m, sizeof(m), slot(n)) == sizeof(m) && m.check == checksum(m) && m.seq >= seq) {
+                        seq     = m.seq;
+                        step    = m.step;
+                        done    = m.done;
+                        pending = m.pending;
                 }
         }
 
-        else {
-                hideCursor();
-        }
-} // end FileDisplay::edit
+        marked = done;
+
+        return seq > 0;
+} // end Journal::load
 
 //--------------------------------------------------------------------
-// Jump a specific percentage forward / backward
+// Record the progress, data before the mark must be on disk
 
-void FileDisplay::skip(bool upwards=false)
+bool Journal::mark(File fd, Size len)
 {
-        FPos step = filesize / 100;
+        pending  = len;
+        marked   = done;
+        markTime = time(NULL);
 
-        if (upwards) {
-                move(step * -skipBack);
+        if (jfd < 0) {
+                return true;
         }
-        else {
-                move(step * skipForw);
+
+        if (fd >= 0 && fdatasync(fd) == ERR) {
+                return false;
         }
-}
 
-//--------------------------------------------------------------------
-// Synchronize the plains
-//
-// '1' | upper:  sync file1 with file2
-// '2' | lower:  sync file2 with file1
+        JournalMark m = { ++seq, step, done, len, 0 };
+        m.check = checksum(m);
 
-void FileDisplay::sync(const FileDisplay* other)
-{
-        if (other->dataSize) {
-                moveTo(other->offset);
-        }
-        else {
-                moveToEnd();
-        }
+        return WriteAt(jfd, &m, sizeof(m), slot(seq)) == sizeof(m) && fdatasync(jfd) == OK;
 }
 
 //--------------------------------------------------------------------
-// Change the file position  ##:to
+// The next 'len' bytes of an overlapping move overwrite part of their
+// own source: only that part is saved, the last 'delta' bytes (upwards
+// the first) stay in place until the group is done.
 
-void FileDisplay::moveTo(FPos newOffset)
+bool Journal::keep(File fd, Size len)
 {
-        if (newOffset < 0) {
-                offset = 0;
-        }
-        else if (newOffset > filesize) {
-                offset = filesize;
-        }
-        else {
-                offset = newOffset;
-        }
+        JournalStep &st = plan[step];
+
+        bool upwards = st.dst > st.src;
+        Size delta   = upwards ? st.dst - st.src : st.src - st.dst,
+             risk    = len > delta ? len - delta : 0;
+        FPos at      = upwards ? st.len - done - risk : done;
+
+        for (Size n=0, part; jfd >= 0 && n < risk; n += part) {
+                part = min((Size) staticSize, risk - n);
 
-        SeekFile(fd, offset);
+                if (ReadAt(fd, buffer, part, st.src + at + n) != part ||
+                    WriteAt(jfd, buffer, part, slot(seq + 1) + 4096 + n) != part) {
+                        return false;
+                }
+        }
 
-        dataSize = ReadFile(fd, dataF, bufSize);
+        return mark(fd, len);
 }
 
 //--------------------------------------------------------------------
-// Change the file position by searching
+// Finish a group which was in flight: the saved part from the journal,
+// the rest from the file in the direction of the move
 
-void FileDisplay::moveForw(const Byte* searchFor, Size searchLen)
+bool Journal::settle(File fd)
 {
-        FPos newPos = searchOff > 0 ? searchOff + 1 : (searchOff < 0 ? 1 : offset);
-        Full leader = 0;
-        Size bias   = 0;
+        if (! pending || jfd < 0) {
+                pending = 0;
 
-        while (! *(searchFor + bias) && bias < searchLen) {
-                ++bias;
+                return true;
         }
 
-        if (bias == searchLen) {
-                bias = 0;
-        }
-        else {
-                for (Size i=0; i < 8; ++i) {
-                        leader = leader << 8 | *(searchFor + bias);
+        JournalStep &st = plan[step];
+
+        bool upwards = st.dst > st.src;
+        Size delta   = upwards ? st.dst - st.src : st.src - st.dst,
+             risk    = pending > delta ? pending - delta : 0,
+             rest    = pending - risk;
+        FPos rel     = upwards ? st.len - done - pending : done,
+             saved   = upwards ? rel + rest : rel,
+             from    = upwards ? rel : rel + risk;
+
+        for (Size n=0, part; n < risk; n += part) {
+                part = min((Size) staticSize, risk - n);
+
+                if (ReadAt(jfd, buffer, part, slot(seq) + 4096 + n) != part ||
+                    WriteAt(fd, buffer, part, st.dst + saved + n) != part) {
+                        return false;
                 }
         }
 
-        for (;;) {
-                SeekFile(fd, newPos);
-                Size bytesRead = ReadFile(fd, buffer, staticSize);
+        for (Size n=0, part; n < rest; n += part) {
+                part = min((Size) staticSize, rest - n);
 
-                if (bytesRead < searchLen || stopRead) {
-                        break;
-                }
+                FPos at = from + (upwards ? rest - n - part : n);
 
-                if (ignoreCase) {
-                        lowCase(buffer, bytesRead);
+                if (ReadAt(fd, buffer, part, st.src + at) != part ||
+                    WriteAt(fd, buffer, part, st.dst + at) != part) {
+                        return false;
                 }
+        }
 
-                for (Size i=0; i <= bytesRead - searchLen; ++i) {
-                        Full turbo = *(Full*) (buffer + i + bias);
+        done += pending;
 
-                        if (! turbo) {
-                                if (leader) {
-                                        goto incr;
-                                }
-                                else {
-                                        goto skip;
-                                }
-                        }
+        return mark(fd);
+}
 
-                        turbo ^= leader;
+//--------------------------------------------------------------------
+// Replace the plan with its reversal: undo moves, restore saved bytes
 
-                        if      (! (turbo & 0x00000000000000FF)) { i += 0; }
-                        else if (! (turbo & 0x000000000000FF00)) { i += 1; }
-                        else if (! (turbo & 0x0000000000FF0000)) { i += 2; }
-                        else if (! (turbo & 0x00000000FF000000)) { i += 3; }
-                        else if (! (turbo & 0x000000FF00000000)) { i += 4; }
-                        else if (! (turbo & 0x0000FF0000000000)) { i += 5; }
-                        else if (! (turbo & 0x00FF000000000000)) { i += 6; }
-                        else if (! (turbo & 0xFF00000000000000)) { i += 7; }
-                        else {
-incr:                           i += 7;
-cont:                           continue;
-                        }
+bool Journal::rollback(File fd)
+{
+        if (lossy || ! settle(fd)) {
+                return false;
+        }
 
-skip:                   if (searchFor[searchLen - 1] == buffer[i + searchLen - 1]) {
-                                Size j = 0;
-                                for (; j + 7 < searchLen; j+=8) {
-                                        if (*(Full*) (searchFor  + j) !=
-                                            *(Full*) (buffer + i + j)) {
-                                                goto cont;
-                                        }
-                                }
+        StepDeq back;
 
-                                if (searchLen != j) {  // shl mask 63
-                                        if ((*(Full*) (searchFor  + j) ^
-                                             *(Full*) (buffer + i + j) )
-                                             << 8 * (8 - searchLen + j)) {
-                                                goto cont;
-                                        }
-                                }
+        for (Size i = min(step, (Size) plan.size() - 1); i >= 0; --i) {
+                JournalStep st = plan[i];
 
-                                if (i > bytesRead - searchLen) {  // limit turbo
-                                        goto cont;
-                                }
+                Size len = i == step ? done : st.len;
 
-                                newPos    = newPos + i;
-                                searchOff = newPos ? newPos : -1;  // tri-state
-                                se4rch    = searchLen;
+                if (st.kind != stepMove || ! len) {
+                        continue;
+                }
 
-                                moveTo(newPos - (searchOff >= searchIndent ? searchIndent : 0));
-                                return;
-                        }
+                if (st.dst > st.src) {  // upwards: done from the end
+                        st.src += st.len - len;
+                        st.dst += st.len - len;
                 }
 
-                newPos += staticSize - searchLen + 1;
+                back.push_back({ st.dst, st.src, len, stepMove, 0 });
         }
 
-        moveTo(stopRead ? newPos : filesize);
+        for (auto &st : undos) {
+                back.push_back(st);
+        }
 
-        searchOff = 0;
-} // end FileDisplay::moveForw
+        plan.swap(back);
+        undos.clear();
+
+        reverse = true;
+
+        Size size = newSize;
+
+        newSize  = origSize;
+        origSize = max(origSize, size);
+
+        return create();
+} // end Journal::rollback
 
 //--------------------------------------------------------------------
-// Change the file position by searching backwards
+// Write is complete
 
-void FileDisplay::moveBack(const Byte* searchFor, Size searchLen)
+void Journal::remove()
 {
-        FPos newPos = searchOff > 0 ? searchOff : offset;
-        Full leader = 0;
-        Size bias   = 0;
+        if (jfd >= 0) {
+                close(jfd);
+                jfd = -1;
 
-        while (! *(searchFor + bias) && bias < searchLen) {
-                ++bias;
+                unlink(path.c_str());
         }
+}
 
-        if (bias == searchLen) {
-                bias = 0;
-        }
-        else {
-                for (Size i=0; i < 8; ++i) {
-                        leader = leader << 8 | *(searchFor + bias);
-                }
-        }
+//====================================================================
+// Class PieceTable  ##:piece
+//
+// The edited file: pieces of the original file and of an append-only
+// buffer, the buffer never shrinks.  The pieces are held in short runs
+// with their byte length, a position is found run by run.
+// Every edit exchanges a byte range, the replaced pieces are its undo.
+// Ranges refer to the other file or repeat a pattern, never expanded.
+
+const Full      srcFile  = 0,  // original file
+                srcAdd   = 1,  // append buffer
+                srcOther = 2,  // other file
+                srcFill  = 3;  // pattern in the append buffer
+
+const Size      runMax   = 256;  // pieces per run
+
+struct Piece {
+        FPos    pos;    // offset in the source, fill: in the repeated pattern
+        Size    len;
+        Full    src;
+        Full    style;  // cInsert | cEdit, 0: original
+        FPos    base;   // fill: pattern offset in the buffer
+        Size    pat;    // fill: pattern length
+};
 
-        if (newPos + searchLen - 1 > filesize) {
-                newPos = filesize - searchLen + 1;
-        }
+typedef deque<Piece>    PieceDeq;
+typedef vector<Piece>   PieceVec;
 
-        for (;;) {
-                newPos -= staticSize - searchLen + 1;
+struct PieceRun {
+        Size            len;     // bytes
+        PieceVec        pieces;
+};
 
-                SeekFile(fd, newPos > 0 ? newPos : 0);
-                Size bytesRead = ReadFile(fd, buffer, staticSize);
+struct PieceEdit {
+        FPos            pos;     // range [pos, pos + len) holds
+        Size            len;
+        PieceDeq        pieces;  // these before the exchange
+};
 
-                if (ignoreCase) {
-                        lowCase(buffer, bytesRead);
-                }
+class PieceTable
+{
+    friend class FileDisplay;
+
+        File              fd    = -1,
+                          other = -1;
+        string            otherName;
+        Size              origSize = 0;
+        vector<PieceRun>  runs;
+        string            add;
+        deque<PieceEdit>  undos,
+                          redos;
+
+        void    join(PieceDeq& out, Piece p);
+        void    merge(PieceVec& d, Size i);
+        bool    moved(const Piece& p)                   { return p.src == srcFile && p.len >= 4096; }
+        void    locate(FPos pos, Size& r, Size& i, FPos& at);
+        void    split(FPos pos);
+        void    balance(Size r);
+        void    exchange(PieceEdit& e);
+        void    splice(FPos pos, Size del, const Piece* ins);
+        PieceDeq list();
 
-                for (Size i = staticSize + (newPos < 0 ? newPos : 0) - searchLen; i >= 0; --i) {
-                        Full turbo = *(Full*) (buffer + i + bias - 7);
+    public:
+        Size            size = 0;
+
+        void    init(File Fd, Size Filesize);
+        void    link(File Other, const char* Name);
+        Size    read(FPos pos, Byte* buf, Size len, Byte* style=NULL);
+        Byte    at(FPos pos)                            { Byte b = 0; read(pos, &b, 1); return b; }
+
+        void    replace(FPos pos, Byte b);
+        void    insert(FPos pos, const Byte* buf, Size len);
+        void    erase(FPos pos, Size len)               { splice(pos, len, NULL); }
+        void    fill(FPos pos, Size len, const Byte* pat, Size patLen);
+        void    copy(FPos pos, Size len, FPos from);
+        void    assign(PieceDeq& out);
+        bool    undo();
+        bool    redo();
+
+        bool    changed();
+        void    plan(Journal& jr);
+}; // end PieceTable
 
-                        if (! turbo) {
-                                if (leader) {
-                                        goto decr;
-                                }
-                                else {
-                                        goto skip;
-                                }
-                        }
+//====================================================================
+// Class PieceTable member functions
 
-                        turbo ^= leader;
+//--------------------------------------------------------------------
+// Start with the whole file as one piece
 
-                        if      (! (turbo & 0xFF00000000000000)) { i -= 0; }
-                        else if (! (turbo & 0x00FF000000000000)) { i -= 1; }
-                        else if (! (turbo & 0x0000FF0000000000)) { i -= 2; }
-                        else if (! (turbo & 0x000000FF00000000)) { i -= 3; }
-                        else if (! (turbo & 0x00000000FF000000)) { i -= 4; }
-                        else if (! (turbo & 0x0000000000FF0000)) { i -= 5; }
-                        else if (! (turbo & 0x000000000000FF00)) { i -= 6; }
-                        else if (! (turbo & 0x00000000000000FF)) { i -= 7; }
-                        else {
-decr:                           i -= 7;
-cont:                           continue;
-                        }
+void PieceTable::init(File Fd, Size Filesize)
+{
+        fd       = Fd;
+        origSize = size = Filesize;
 
-skip:                   if (searchFor[searchLen - 1] == buffer[i + searchLen - 1]) {
-                                Size j = 0;
-                                for (; j + 7 < searchLen; j+=8) {
-                                        if (*(Full*) (searchFor  + j) !=
-                                            *(Full*) (buffer + i + j)) {
-                                                goto cont;
-                                        }
-                                }
+        runs.clear();
+        undos.clear();
+        redos.clear();
+        add.clear();
 
-                                if (searchLen != j) {
-                                        if ((*(Full*) (searchFor  + j) ^
-                                             *(Full*) (buffer + i + j) )
-                                             << 8 * (8 - searchLen + j)) {
-                                                goto cont;
-                                        }
-                                }
+        if (size) {
+                runs.push_back({ size, { { 0, size, srcFile, 0, 0, 0 } } });
+        }
+}
 
-                                if (i < 0) {
-                                        goto cont;
-                                }
+//--------------------------------------------------------------------
+// Source for range copies, the journal needs the full path
 
-                                newPos    = (newPos > 0 ? newPos : 0) + i;
-                                searchOff = newPos ? newPos : -1;
-                                se4rch    = searchLen;
+void PieceTable::link(File Other, const char* Name)
+{
+        char *path = Name ? realpath(Name, NULL) : NULL;
 
-                                moveTo(newPos - (searchOff >= searchIndent ? searchIndent : 0));
-                                return;
-                        }
-                }
+        other     = Other;
+        otherName = path ? path : "";
 
-                if (newPos <= 0 || stopRead) {
-                        break;
+        free(path);
+}
+
+//--------------------------------------------------------------------
+// Append a piece, merge with a contiguous predecessor
+
+void PieceTable::join(PieceDeq& out, Piece p)
+{
+        if (out.size()) {
+                Piece &b = out.back();
+
+                if (b.src == p.src && b.style == p.style && b.pos + b.len == p.pos && b.base == p.base) {
+                        b.len += p.len;
+                        return;
                 }
         }
 
-        moveTo(stopRead ? newPos : 0);
-
-        searchOff = 0;
-} // end FileDisplay::moveBack
+        out.push_back(p);
+}
 
 //--------------------------------------------------------------------
-// Seek to next byte not equal to current head
+// Merge pieces i-1 and i if contiguous
 
-void FileDisplay::seekNotChar(bool upwards=false)
+void PieceTable::merge(PieceVec& d, Size i)
 {
-        const int blockSize = 1024 * 1024;
+        if (i <= 0 || i >= (Size) d.size()) {
+                return;
+        }
+
+        Piece &a = d[i - 1],
+              &b = d[i];
+
+        if (a.src == b.src && a.style == b.style && a.pos + a.len == b.pos && a.base == b.base) {
+                a.len += b.len;
+                d.erase(d.begin() + i);
+        }
+}
+
+//--------------------------------------------------------------------
+// Run r and piece i holding pos, 'at' is where the piece starts.
+// Past the end: r == runs.size()
+
+void PieceTable::locate(FPos pos, Size& r, Size& i, FPos& at)
+{
+        at = 0;
+        i  = 0;
+
+        for (r = 0; r < (Size) runs.size() && at + runs[r].len <= pos; ++r) {
+                at += runs[r].len;
+        }
+
+        for (; r < (Size) runs.size() && at + runs[r].pieces[i].len <= pos; ++i) {
+                at += runs[r].pieces[i].len;
+        }
+}
+
+//--------------------------------------------------------------------
+// A piece boundary at pos
+
+void PieceTable::split(FPos pos)
+{
+        Size r, i;
+        FPos at;
+
+        locate(pos, r, i, at);
+
+        if (r == (Size) runs.size() || at == pos) {
+                return;
+        }
+
+        PieceVec &d = runs[r].pieces;
+        Piece     b = d[i];
+
+        d[i].len = pos - at;
+        b.pos   += pos - at;
+        b.len   -= pos - at;
+
+        d.insert(d.begin() + i + 1, b);
+}
+
+//--------------------------------------------------------------------
+// Long runs are cut in halves or less, empty ones dropped
+
+void PieceTable::balance(Size r)
+{
+        if (runs[r].pieces.empty()) {
+                runs.erase(runs.begin() + r);
+                return;
+        }
+
+        if ((Size) runs[r].pieces.size() <= runMax) {
+                return;
+        }
+
+        vector<PieceRun> part;
+        PieceVec &d = runs[r].pieces;
+
+        Size n    = d.size(),
+             each = (n + n / (runMax / 2) - 1) / (n / (runMax / 2));  // half full, room to grow
+
+        for (Size k=0; k < n; k += each) {
+                part.push_back({ 0, PieceVec(d.begin() + k, d.begin() + min(k + each, n)) });
+
+                for (auto &p : part.back().pieces) {
+                        part.back().len += p.len;
+                }
+        }
+
+        runs[r].len = part[0].len;
+        runs[r].pieces.swap(part[0].pieces);
+        runs.insert(runs.begin() + r + 1, part.begin() + 1, part.end());
+}
+
+//--------------------------------------------------------------------
+// Put e.pieces in place of the range, e becomes its inverse
+
+void PieceTable::exchange(PieceEdit& e)
+{
+        Size ins = 0;
+
+        for (auto &p : e.pieces) {
+                ins += p.len;
+        }
+
+        split(e.pos);
+        split(e.pos + e.len);
+
+        Size r, i;
+        FPos at;
+
+        locate(e.pos, r, i, at);
+
+        if (r == (Size) runs.size()) {  // append
+                if (runs.empty()) {
+                        runs.push_back({ 0, PieceVec() });
+                }
+
+                r = runs.size() - 1;
+                i = runs[r].pieces.size();
+        }
+
+        PieceDeq old;
+        Size     k = r;
+
+        for (Size n=0; n < e.len; ++k) {  // whole pieces after split
+                PieceVec &d = runs[k].pieces;
+                Size      j = k == r ? i : 0,
+                          got = 0;
+
+                while (j < (Size) d.size() && n + got < e.len) {
+                        got += d[j++].len;
+                }
+
+                old.insert(old.end(), d.begin() + (k == r ? i : 0), d.begin() + j);
+                d.erase(d.begin() + (k == r ? i : 0), d.begin() + j);
+
+                runs[k].len -= got;
+                n           += got;
+        }
+
+        PieceVec &d = runs[r].pieces;
+
+        d.insert(d.begin() + i, e.pieces.begin(), e.pieces.end());
+        runs[r].len += ins;
+
+        merge(d, i + e.pieces.size());
+        merge(d, i);
+
+        size += ins - e.len;
+
+        e.len = ins;
+        e.pieces.swap(old);
+
+        for (k = min(k, (Size) runs.size() - 1); k >= r; --k) {  // emptied and grown ones
+                balance(k);
+        }
+}
+
+//--------------------------------------------------------------------
+// Delete 'del' bytes at 'pos' and insert a piece there, one undo step
+
+void PieceTable::splice(FPos pos, Size del, const Piece* ins)
+{
+        del = min(del, size - pos);
+
+        if (del <= 0 && ! ins) {
+                return;
+        }
+
+        undos.push_back({ pos, del, PieceDeq() });
+        redos.clear();
+
+        if (ins) {
+                undos.back().pieces.push_back(*ins);
+        }
+
+        exchange(undos.back());
+}
+
+//--------------------------------------------------------------------
+// New piece list as one undo step
+
+void PieceTable::assign(PieceDeq& out)
+{
+        undos.push_back({ 0, size, PieceDeq() });
+        redos.clear();
+
+        undos.back().pieces.swap(out);
+
+        exchange(undos.back());
+}
+
+//--------------------------------------------------------------------
+// All pieces, contiguous ones merged
+
+PieceDeq PieceTable::list()
+{
+        PieceDeq out;
+
+        for (auto &r : runs) {
+                for (auto &p : r.pieces) {
+                        join(out, p);
+                }
+        }
+
+        return out;
+}
+
+//--------------------------------------------------------------------
+// Edit operations
+
+void PieceTable::replace(FPos pos, Byte b)
+{
+        Byte old,
+             style = 0;
+
+        if (read(pos, &old, 1, &style) && old == b) {
+                return;
+        }
+
+        Piece p = { (FPos) add.size(), 1, srcAdd, (Full) (style == cInsert ? cInsert : cEdit), 0, 0 };
+
+        add += b;
+
+        splice(pos, pos < size ? 1 : 0, &p);
+}
+
+void PieceTable::insert(FPos pos, const Byte* buf, Size len)
+{
+        Piece p = { (FPos) add.size(), len, srcAdd, cInsert, 0, 0 };
+
+        add.append((const char*) buf, len);
+
+        splice(pos, 0, &p);
+}
+
+void PieceTable::fill(FPos pos, Size len, const Byte* pat, Size patLen)
+{
+        Piece p = { 0, len, srcFill, cEdit, (FPos) add.size(), patLen };
+
+        add.append((const char*) pat, patLen);
+
+        splice(pos, len, &p);
+}
+
+void PieceTable::copy(FPos pos, Size len, FPos from)
+{
+        Piece p = { from, len, srcOther, cEdit, 0, 0 };
+
+        splice(pos, len, &p);
+}
+
+bool PieceTable::undo()
+{
+        if (undos.empty()) {
+                return false;
+        }
+
+        redos.push_back(PieceEdit());
+        swap(redos.back(), undos.back());
+        undos.pop_back();
+
+        exchange(redos.back());
+
+        return true;
+}
+
+bool PieceTable::redo()
+{
+        if (redos.empty()) {
+                return false;
+        }
+
+        undos.push_back(PieceEdit());
+        swap(undos.back(), redos.back());
+        redos.pop_back();
+
+        exchange(undos.back());
+
+        return true;
+}
+
+//--------------------------------------------------------------------
+// Read the edited file, optional the style of each byte
+
+Size PieceTable::read(FPos pos, Byte* buf, Size len, Byte* style)
+{
+        Size r, i,
+             have = 0;
+        FPos at;
+
+        locate(pos, r, i, at);
+
+        for (; r < (Size) runs.size() && at < pos + len; ++r, i = 0) {
+                for (; i < (Size) runs[r].pieces.size() && at < pos + len; ++i) {
+                        const Piece &p = runs[r].pieces[i];
+
+                        FPos lo = max(pos, at),
+                             hi = min(pos + len, at + p.len);
+
+                        if (lo < hi) {
+                                Byte *out = buf + (lo - pos);
+
+                                if (p.src == srcAdd) {
+                                        memcpy(out, add.data() + p.pos + (lo - at), hi - lo);
+                                }
+                                else if (p.src == srcFill) {
+                                        for (FPos k = p.pos + (lo - at), n=0; n < hi - lo; ++k, ++n) {
+                                                out[n] = add[p.base + k % p.pat];
+                                        }
+                                }
+                                else if (ReadAt(p.src == srcOther ? other : fd, out, hi - lo, p.pos + (lo - at)) != hi - lo) {
+                                        memset(out, 0, hi - lo);
+                                }
+
+                                if (style) {
+                                        memset(style + (lo - pos), p.style, hi - lo);
+                                }
+
+                                have += hi - lo;
+                        }
+
+                        at += p.len;
+                }
+        }
+
+        return have;
+} // end PieceTable::read
+
+//--------------------------------------------------------------------
+// Differs from the original file
+
+bool PieceTable::changed()
+{
+        if (size != origSize) {
+                return true;
+        }
+
+        FPos at = 0;
+
+        for (auto &r : runs) {
+                for (auto &p : r.pieces) {
+                        if (p.src != srcFile || p.pos != at) {
+                                return true;
+                        }
+
+                        at += p.len;
+                }
+        }
+
+        return false;
+}
+
+//--------------------------------------------------------------------
+// Write plan: every original piece is moved once, downwards ascending
+// and upwards descending, then the new bytes are patched in.  Small
+// original pieces go with the patches: one write instead of a move
+// between every two edits.
+// Original bytes which are dropped or overwritten are kept for undo,
+// unless they exceed warnResize.
+
+void PieceTable::plan(Journal& jr)
+{
+        PieceDeq pieces = list();
+        StepDeq  ups;
+
+        FPos at   = 0,
+             kept = 0;  // original bytes before are accounted
+
+        Size lost = origSize;
+
+        for (auto &p : pieces) {
+                if (moved(p)) {
+                        lost -= p.len;
+                }
+        }
+
+        jr.origSize = origSize;
+        jr.newSize  = size;
+        jr.lossy    = lost > warnResize;  // too much to keep
+        jr.other    = otherName;
+
+        for (auto &p : pieces) {
+                if (moved(p)) {
+                        if (p.pos < at) {
+                                ups.push_front({ p.pos, at, p.len, stepMove, 0 });
+                        }
+                        else {
+                                jr.move(p.pos, at, p.len);
+                        }
+
+                        for (FPos gap = kept; gap < p.pos && ! jr.lossy; gap += staticSize) {
+                                Size len = min((Size) staticSize, p.pos - gap);
+
+                                if (ReadAt(fd, buffer, len, gap) == len) {
+                                        jr.write(gap, buffer, len, true);
+                                }
+                        }
+
+                        kept = max(kept, p.pos + p.len);
+                }
+
+                at += p.len;
+        }
+
+        jr.plan.insert(jr.plan.end(), ups.begin(), ups.end());
+
+        for (FPos gap = kept; gap < origSize && ! jr.lossy; gap += staticSize) {
+                Size len = min((Size) staticSize, origSize - gap);
+
+                if (ReadAt(fd, buffer, len, gap) == len) {
+                        jr.write(gap, buffer, len, true);
+                }
+        }
+
+        string patch;
+
+        at = 0;
+
+        for (auto &p : pieces) {
+                if (p.src == srcAdd) {
+                        patch.append(add, p.pos, p.len);
+                }
+
+                else if (p.src == srcFile && ! moved(p)) {
+                        patch.resize(patch.size() + p.len);
+
+                        ReadAt(fd, &patch[patch.size() - p.len], p.len, p.pos);
+                }
+
+                else if (patch.size()) {
+                        jr.write(at - patch.size(), (const Byte*) patch.data(), patch.size());
+                        patch.clear();
+                }
+
+                if (p.src == srcFill) {  // rotate to start at dst
+                        Size phase = p.pos % p.pat;
+
+                        jr.fill(at, p.len, add.substr(p.base + phase, p.pat - phase) + add.substr(p.base, phase));
+                }
+
+                else if (p.src == srcOther) {
+                        jr.copy(p.pos, at, p.len);
+                }
+
+                at += p.len;
+        }
+
+        jr.write(at - patch.size(), (const Byte*) patch.data(), patch.size());
+} // end PieceTable::plan
+
+//====================================================================
+// Class BlockCache  ##:cache
+//
+// LRU blocks of one file, shared by all views of it
+
+class BlockCache
+{
+        dev_t                   dev;
+        ino_t                   ino;
+        int                     users;
+
+        Byte                   *data;
+        FPos                    at[cacheSlots];
+        Size                    len[cacheSlots];
+        Full                    use[cacheSlots];
+        Full                    tick;
+
+    public:
+                BlockCache(const struct stat& st):
+                                        dev(st.st_dev), ino(st.st_ino), users(0),
+                                        data(new Byte[cacheSlots * cacheBlock]), tick(0)
+                                                                { memset(use, 0, sizeof(use)); flush(); }
+               ~BlockCache()                                    { delete [] data; }
+
+        static BlockCache *attach(File fd, BlockCache* old=NULL);
+        static void        detach(BlockCache* bc);
+
+        void            flush()                                 { memset(at, -1, sizeof(at)); }
+        void            drop(FPos from);
+        int             block(File fd, FPos blk, int way);
+        Size            length(int slot) const                  { return len[slot]; }
+        const Byte     *bytes(int slot) const                   { return data + slot * cacheBlock; }
+}; // end BlockCache
+
+deque<BlockCache*> blockCaches;
+
+//--------------------------------------------------------------------
+// Share the cache of an open file, a new one for a file not yet open.
+// The file of old was written: flush it, or leave it if replaced
+
+BlockCache *BlockCache::attach(File fd, BlockCache* old)
+{
+        struct stat st;
+        BlockCache *bc = NULL;
+
+        fstat(fd, &st);
+
+        for (BlockCache* c : blockCaches) {
+                if (c->dev == st.st_dev && c->ino == st.st_ino) {
+                        bc = c;
+                }
+        }
+
+        if (bc && bc == old) {
+                bc->flush();
+                return bc;
+        }
+
+        if (! bc) {
+                blockCaches.push_back(bc = new BlockCache(st));
+        }
+
+        if (old) {
+                detach(old);
+        }
+
+        ++bc->users;
+
+        return bc;
+}
+
+void BlockCache::detach(BlockCache* bc)
+{
+        if (--bc->users) {
+                return;
+        }
+
+        for (auto it = blockCaches.begin(); it != blockCaches.end(); ++it) {
+                if (*it == bc) {
+                        blockCaches.erase(it);
+                        break;
+                }
+        }
+
+        delete bc;
+}
+
+//--------------------------------------------------------------------
+// Forget the blocks from the old end on, the file has grown or shrunk
+
+void BlockCache::drop(FPos from)
+{
+        for (int i = 0; i < cacheSlots; ++i) {
+                if (at[i] >= from) {
+                        at[i] = -1;
+                }
+        }
+}
+
+//--------------------------------------------------------------------
+// Get a cached block, on a miss read it together with
+// its neighbour in the direction of travel
+
+int BlockCache::block(File fd, FPos blk, int way)
+{
+        int slot[2];
+
+        for (int i = 0; i < cacheSlots; ++i) {
+                if (at[i] == blk) {
+                        use[i] = ++tick;
+                        ++io.cacheHits;
+                        return i;
+                }
+        }
+
+        ++io.cacheMisses;
+
+        FPos first = way < 0 && blk ? blk - 1 : blk;
+        struct iovec iov[2];
+
+        for (int n = 0; n < 2; ++n) {  // evict the least recently used
+                slot[n] = 0;
+                for (int i = 1; i < cacheSlots; ++i) {
+                        if (use[i] < use[slot[n]]) {
+                                slot[n] = i;
+                        }
+                }
+                use[slot[n]] = ++tick;
+
+                iov[n].iov_base = data + slot[n] * cacheBlock;
+                iov[n].iov_len  = cacheBlock;
+        }
+
+        Size got = preadv(fd, iov, 2, first * cacheBlock);
+
+        ++io.syscalls;
+        io.bytesRead += max<Size>(got, 0);
+
+        for (int n = 0; n < 2; ++n) {
+                at[slot[n]]  = got < 0 ? -1 : first + n;
+                len[slot[n]] = max<Size>(0, min<Size>(got - n * cacheBlock, cacheBlock));
+        }
+
+        return slot[first == blk ? 0 : 1];
+} // end BlockCache::block
+
+//====================================================================
+// Class EntropyMap  ##:map
+//
+// Entropy of the cells of one file, computed by a pool of threads.
+// Memory is bounded by the cell count, cancelled cells are redone
+
+const int mapZero = 0x10000,  // only zeros
+          mapText = 0x20000,  // mostly printable
+          mapBits = 0xFFFF;   // milli-bits per byte
+
+class EntropyMap
+{
+        string                  name;
+        FPos                    size;
+        FPos                    cell;
+        int                     cells;
+
+        atomic<int>            *value;  // -1 == pending
+        atomic<int>             next;
+        atomic<int>             filled;
+        atomic<int>             active;
+        atomic<bool>            stop;
+
+        deque<thread>           workers;
+
+        void    work();
+
+    public:
+                EntropyMap(): size(0), cell(0), cells(0), value(NULL),
+                                        next(0), filled(0), active(0), stop(false) {}
+               ~EntropyMap()                            { cancel(); delete [] value; }
+
+        void    start(const char* file, FPos filesize, FPos cellSize);
+        void    cancel();
+
+        bool    running() const                         { return active > 0; }
+        int     percent() const                         { return cells ? filled * 100LL / cells : 0; }
+        int     at(int i) const                         { return value[i]; }
+}; // end EntropyMap
+
+EntropyMap entropyMap;
+
+//--------------------------------------------------------------------
+// Byte histogram
+
+void histogram(const Byte* buf, Size len, Full* hist)
+{
+        kernel.histogram(buf, len, hist);
+}
+
+//--------------------------------------------------------------------
+// Shannon entropy in milli-bits, zero and text flagged
+
+int entropy(const Full* hist)
+{
+        Full total = 0,
+             text  = hist['\t'] + hist['\n'] + hist['\r'];
+        double bits = 0;
+
+        for (int b = 0; b < 256; ++b) {
+                total += hist[b];
+        }
+
+        if (hist[0] == total) {
+                return mapZero;
+        }
+
+        for (int b = 0; b < 256; ++b) {
+                if (hist[b]) {
+                        double p = (double) hist[b] / total;
+
+                        bits -= p * log2(p);
+                }
+        }
+
+        for (int b = ' '; b < 0x7F; ++b) {
+                text += hist[b];
+        }
+
+        return lround(bits * 1000) | (text * 10 >= total * 9 ? mapText : 0);
+}
+
+//--------------------------------------------------------------------
+// Start or resume the map, a new file or size begins a new one
+
+void EntropyMap::start(const char* file, FPos filesize, FPos cellSize)
+{
+        if (name != file || size != filesize || cell != cellSize) {
+                cancel();
+
+                name  = file;
+                size  = filesize;
+                cell  = cellSize;
+                cells = (size + cell - 1) / cell;
+
+                delete [] value;
+                value = new atomic<int>[cells];
+
+                for (int i = 0; i < cells; ++i) {
+                        value[i] = -1;
+                }
+
+                filled = 0;
+        }
+
+        if (running() || filled == cells) {
+                return;
+        }
+
+        cancel();  // join the finished
+
+        int count = max<int>(1, min<int>(thread::hardware_concurrency(), mapThreads));
+
+        active = count;
+
+        for (int i = 0; i < count; ++i) {
+                workers.push_back(thread(&EntropyMap::work, this));
+        }
+}
+
+void EntropyMap::cancel()
+{
+        stop = true;
+
+        for (thread& t : workers) {
+                t.join();
+        }
+
+        workers.clear();
+
+        stop = false;
+        next = 0;
+}
+
+//--------------------------------------------------------------------
+// Worker: claim the next pending cell, read it in chunks
+
+void EntropyMap::work()
+{
+        File  fd  = OpenFile(name.c_str());
+        Byte *buf = new Byte[mapChunk];
+        Full  hist[256];
+
+        for (int i; fd >= 0 && ! stop && (i = next++) < cells;) {
+                if (value[i] >= 0) {
+                        continue;
+                }
+
+                FPos pos = i * cell,
+                     end = min(pos + cell, size);
+                Size got = 0;
+
+                memset(hist, 0, sizeof(hist));
+
+                for (; pos < end && ! stop; pos += got) {
+                        if ((got = pread(fd, buf, min<FPos>(mapChunk, end - pos), pos)) <= 0) {
+                                break;
+                        }
+
+                        histogram(buf, got, hist);
+                }
+
+                if (! stop) {
+                        value[i] = entropy(hist);
+                        ++filled;
+                }
+        }
+
+        delete [] buf;
+
+        if (fd >= 0) {
+                close(fd);
+        }
+
+        --active;
+} // end EntropyMap::work
+
+//====================================================================
+// Checksums  ##:sum
+//
+// CRC32C runs in parallel parts and is combined, xxHash64 and SHA-256
+// are sequential by definition: their reads are announced one chunk ahead
+
+enum SumAlgo { sumCRC32C, sumXXH64, sumSHA256 };
+
+const char *sumNames[] = { "CRC32C", "xxHash64", "SHA-256" };
+
+Half crcTable[8][256];  // slicing by 8
+
+Half crc32cSoft(Half crc, const Byte* p, Size n)
+{
+        for (; n >= 8; p += 8, n -= 8) {
+                Full w = *(const Full*) p ^ crc;
+
+                crc = crcTable[7][w & 0xFF]         ^ crcTable[6][(w >> 8) & 0xFF] ^
+                      crcTable[5][(w >> 16) & 0xFF] ^ crcTable[4][(w >> 24) & 0xFF] ^
+                      crcTable[3][(w >> 32) & 0xFF] ^ crcTable[2][(w >> 40) & 0xFF] ^
+                      crcTable[1][(w >> 48) & 0xFF] ^ crcTable[0][w >> 56];
+        }
+
+        while (n--) {
+                crc = crcTable[0][(crc ^ *p++) & 0xFF] ^ crc >> 8;
+        }
+
+        return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+Half crc32cHard(Half crc, const Byte* p, Size n)
+{
+        Full c = crc;
+
+        for (; n >= 8; p += 8, n -= 8) {
+                c = __builtin_ia32_crc32di(c, *(const Full*) p);
+        }
+
+        while (n--) {
+                c = __builtin_ia32_crc32qi(c, *p++);
+        }
+
+        return c;
+}
+#endif
+
+Half (*crc32c)(Half crc, const Byte* p, Size n) = crc32cSoft;
+
+void initCRC()
+{
+        for (Half b = 0; b < 256; ++b) {
+                Half c = b;
+
+                for (int k = 0; k < 8; ++k) {
+                        c = c & 1 ? c >> 1 ^ 0x82F63B78 : c >> 1;
+                }
+
+                crcTable[0][b] = c;
+        }
+
+        for (int t = 1; t < 8; ++t) {
+                for (int b = 0; b < 256; ++b) {
+                        crcTable[t][b] = crcTable[t - 1][b] >> 8 ^ crcTable[0][crcTable[t - 1][b] & 0xFF];
+                }
+        }
+
+#if defined(__x86_64__)
+        if (__builtin_cpu_supports("sse4.2")) {
+                crc32c = crc32cHard;
+        }
+#endif
+}
+
+//--------------------------------------------------------------------
+// CRC of two parts from the CRCs of the parts (zlib method)
+
+Half gf2Times(const Half* mat, Half vec)
+{
+        Half sum = 0;
+
+        for (; vec; vec >>= 1, ++mat) {
+                if (vec & 1) {
+                        sum ^= *mat;
+                }
+        }
+
+        return sum;
+}
+
+void gf2Square(Half* square, const Half* mat)
+{
+        for (int n = 0; n < 32; ++n) {
+                square[n] = gf2Times(mat, mat[n]);
+        }
+}
+
+Half crcCombine(Half crc1, Half crc2, FPos len2)
+{
+        Half even[32],
+             odd[32];
+
+        odd[0] = 0x82F63B78;  // one zero bit
+
+        for (int n = 1; n < 32; ++n) {
+                odd[n] = 1U << (n - 1);
+        }
+
+        gf2Square(even, odd);  // two zero bits
+        gf2Square(odd, even);  // four
+
+        while (len2 > 0) {
+                gf2Square(even, odd);
+
+                if (len2 & 1) {
+                        crc1 = gf2Times(even, crc1);
+                }
+
+                if (! (len2 >>= 1)) {
+                        break;
+                }
+
+                gf2Square(odd, even);
+
+                if (len2 & 1) {
+                        crc1 = gf2Times(odd, crc1);
+                }
+
+                len2 >>= 1;
+        }
+
+        return crc1 ^ crc2;
+}
+
+//--------------------------------------------------------------------
+// xxHash64, seed 0
+
+class XXH64
+{
+        static const Full p1 = 11400714785074694791ULL,
+                          p2 = 14029467366897019727ULL,
+                          p3 =  1609587929392839161ULL,
+                          p4 =  9650029242287828579ULL,
+                          p5 =  2870177450012600261ULL;
+
+        Full    v[4];
+        Full    total;
+        Byte    mem[32];
+        Size    fill;
+
+        static Full rotl(Full x, int r)                 { return x << r | x >> (64 - r); }
+        static Full round(Full acc, Full in)            { return rotl(acc + in * p2, 31) * p1; }
+        static Full merge(Full h, Full acc)             { return (h ^ round(0, acc)) * p1 + p4; }
+
+    public:
+                XXH64(): total(0), fill(0)              { v[0] = p1 + p2; v[1] = p2; v[2] = 0; v[3] = -p1; }
+
+        void    update(const Byte* p, Size n);
+        Full    digest() const;
+};
+
+void XXH64::update(const Byte* p, Size n)
+{
+        total += n;
+
+        if (fill + n < 32) {
+                memcpy(mem + fill, p, n);
+                fill += n;
+                return;
+        }
+
+        if (fill) {
+                memcpy(mem + fill, p, 32 - fill);
+                p += 32 - fill;
+                n -= 32 - fill;
+
+                for (int i = 0; i < 4; ++i) {
+                        v[i] = round(v[i], ((const Full*) mem)[i]);
+                }
+                fill = 0;
+        }
+
+        for (; n >= 32; p += 32, n -= 32) {
+                for (int i = 0; i < 4; ++i) {
+                        v[i] = round(v[i], ((const Full*) p)[i]);
+                }
+        }
+
+        memcpy(mem, p, n);
+        fill = n;
+}
+
+Full XXH64::digest() const
+{
+        Full h = total < 32 ? p5 :
+                 rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+
+        if (total >= 32) {
+                for (int i = 0; i < 4; ++i) {
+                        h = merge(h, v[i]);
+                }
+        }
+
+        h += total;
+
+        const Byte *p = mem;
+        Size n = fill;
+
+        for (; n >= 8; p += 8, n -= 8) {
+                h = rotl(h ^ round(0, *(const Full*) p), 27) * p1 + p4;
+        }
+
+        if (n >= 4) {
+                h = rotl(h ^ *(const Half*) p * p1, 23) * p2 + p3;
+                p += 4;
+                n -= 4;
+        }
+
+        while (n--) {
+                h = rotl(h ^ *p++ * p5, 11) * p1;
+        }
+
+        h ^= h >> 33;
+        h *= p2;
+        h ^= h >> 29;
+        h *= p3;
+
+        return h ^ h >> 32;
+}
+
+//--------------------------------------------------------------------
+// SHA-256
+
+class SHA256
+{
+        Half    h[8];
+        Byte    block[64];
+        Full    total;
+        Size    fill;
+
+        void    compress(const Byte* p);
+
+    public:
+                SHA256();
+
+        void    update(const Byte* p, Size n);
+        void    digest(Byte* out);
+};
+
+const Half sha256K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+SHA256::SHA256(): total(0), fill(0)
+{
+        static const Half init[8] = {
+                0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+
+        memcpy(h, init, sizeof(h));
+}
+
+void SHA256::compress(const Byte* p)
+{
+        Half w[64], s[8];
+
+        for (int i = 0; i < 16; ++i, p += 4) {
+                w[i] = (Half) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+        }
+
+        for (int i = 16; i < 64; ++i) {
+                Half s0 = (w[i-15] >> 7 | w[i-15] << 25) ^ (w[i-15] >> 18 | w[i-15] << 14) ^ w[i-15] >> 3,
+                     s1 = (w[i-2] >> 17 | w[i-2] << 15)  ^ (w[i-2] >> 19 | w[i-2] << 13)   ^ w[i-2] >> 10;
+
+                w[i] = w[i-16] + s0 + w[i-7] + s1;
+        }
+
+        memcpy(s, h, sizeof(s));
+
+        for (int i = 0; i < 64; ++i) {
+                Half e  = s[4],
+                     a  = s[0],
+                     t1 = s[7] + ((e >> 6 | e << 26) ^ (e >> 11 | e << 21) ^ (e >> 25 | e << 7)) +
+                          ((e & s[5]) ^ (~e & s[6])) + sha256K[i] + w[i],
+                     t2 = ((a >> 2 | a << 30) ^ (a >> 13 | a << 19) ^ (a >> 22 | a << 10)) +
+                          ((a & s[1]) ^ (a & s[2]) ^ (s[1] & s[2]));
+
+                memmove(s + 1, s, 7 * sizeof(Half));
+                s[4] += t1;
+                s[0]  = t1 + t2;
+        }
+
+        for (int i = 0; i < 8; ++i) {
+                h[i] += s[i];
+        }
+}
+
+void SHA256::update(const Byte* p, Size n)
+{
+        total += n;
+
+        if (fill) {
+                Size take = min(n, 64 - fill);
+
+                memcpy(block + fill, p, take);
+                fill += take;
+                p    += take;
+                n    -= take;
+
+                if (fill < 64) {
+                        return;
+                }
+
+                compress(block);
+                fill = 0;
+        }
+
+        for (; n >= 64; p += 64, n -= 64) {
+                compress(p);
+        }
+
+        memcpy(block, p, n);
+        fill = n;
+}
+
+void SHA256::digest(Byte* out)
+{
+        Full bits = total * 8;
+        Byte pad[72] = { 0x80 };
+        Size padLen = (fill < 56 ? 56 : 120) - fill;
+
+        for (int i = 0; i < 8; ++i) {
+                pad[padLen + i] = bits >> (56 - 8 * i);
+        }
+
+        update(pad, padLen + 8);
+
+        for (int i = 0; i < 8; ++i) {
+                out[4*i]     = h[i] >> 24;
+                out[4*i + 1] = h[i] >> 16;
+                out[4*i + 2] = h[i] >> 8;
+                out[4*i + 3] = h[i];
+        }
+}
+
+//--------------------------------------------------------------------
+// Checksum of a range as hex, empty if stopped or unreadable
+
+struct SumJob {
+        File            fd;
+        FPos            from;
+        FPos            len;
+        SumAlgo         algo;
+        atomic<FPos>    done;
+        atomic<bool>   *stop;
+        atomic<bool>    ready;
+        string          result;
+};
+
+bool sumRead(SumJob& job, FPos pos, FPos end, Byte* buf, Size& got)
+{
+        got = pread(job.fd, buf, min<FPos>(mapChunk, end - pos), pos);
+
+        if (got > 0) {
+                job.done += got;
+        }
+
+        return got > 0 && ! *job.stop;
+}
+
+void sumRange(SumJob* job)
+{
+        FPos end = job->from + job->len;
+        Byte *buf = new Byte[mapChunk];
+        Size got  = 0;
+        bool ok   = true;
+        char hex[72];
+
+        if (job->algo == sumCRC32C) {  // parts side by side, then combined
+                int parts = max<int>(1, min<FPos>(min<int>(thread::hardware_concurrency(), mapThreads),
+                                                  job->len / mapChunk));
+                FPos step = job->len / parts;
+                Half crc[mapThreads];
+                bool good[mapThreads];
+                deque<thread> workers;
+
+                for (int i = 0; i < parts; ++i) {
+                        workers.push_back(thread([=, &crc, &good]() {
+                                Byte *own = i ? new Byte[mapChunk] : buf;
+                                FPos  pos = job->from + i * step,
+                                      to  = i == parts - 1 ? end : pos + step;
+                                Size  n   = 0;
+
+                                crc[i]  = ~0U;
+                                good[i] = true;
+
+                                for (; pos < to && (good[i] = sumRead(*job, pos, to, own, n)); pos += n) {
+                                        crc[i] = crc32c(crc[i], own, n);
+                                }
+
+                                crc[i] = ~crc[i];
+
+                                if (i) {
+                                        delete [] own;
+                                }
+                        }));
+                }
+
+                for (thread& t : workers) {
+                        t.join();
+                }
+
+                Half sum = crc[0];
+
+                for (int i = 0; i < parts; ++i) {
+                        ok = ok && good[i];
+
+                        if (i) {
+                                sum = crcCombine(sum, crc[i], i == parts - 1 ? end - job->from - i * step : step);
+                        }
+                }
+
+                sprintf(hex, "%08X", sum);
+        }
+        else {
+                XXH64  xx;
+                SHA256 sha;
+
+                for (FPos pos = job->from; pos < end && (ok = sumRead(*job, pos, end, buf, got)); pos += got) {
+                        posix_fadvise(job->fd, pos + got, mapChunk, POSIX_FADV_WILLNEED);  // next chunk meanwhile
+
+                        if (job->algo == sumXXH64) {
+                                xx.update(buf, got);
+                        }
+                        else {
+                                sha.update(buf, got);
+                        }
+                }
+
+                if (job->algo == sumXXH64) {
+                        sprintf(hex, "%016lX", xx.digest());
+                }
+                else {
+                        Byte d[32];
+
+                        sha.digest(d);
+
+                        for (int i = 0; i < 32; ++i) {
+                                sprintf(hex + 2*i, "%02x", d[i]);
+                        }
+                }
+        }
+
+        delete [] buf;
+
+        job->result = ok ? hex : "";
+        job->ready  = true;
+} // end sumRange
+
+//====================================================================
+// Class StringIndex  ##:str
+//
+// Printable runs (ASCII and UTF-16LE) of one file, scanned in chunks by
+// a pool of threads.  A run belongs to the chunk it starts in
+
+class StringIndex
+{
+    public:
+        struct Run {
+                FPos            off;
+                Half            at;    // in the chunk text
+                Word            len;
+                bool            wide;  // UTF-16LE
+        };
+
+        struct Chunk {
+                vector<Run>     runs;
+                string          text;
+                atomic<bool>    done;
+        };
+
+    private:
+        string                  name;
+        FPos                    size;
+        int                     chunks;
+        Chunk                  *chunk;
+
+        atomic<int>             next;
+        atomic<int>             active;
+        atomic<Full>            kept;    // text bytes
+        atomic<bool>            stop;
+
+        deque<thread>           workers;
+
+        void    work();
+        void    scan(Chunk& c, const Byte* buf, Size n, Size lead, Size own, FPos pos);
+
+    public:
+                StringIndex(): size(0), chunks(0), chunk(NULL), next(0), active(0), kept(0), stop(false) {}
+               ~StringIndex()                           { cancel(); delete [] chunk; }
+
+        void    start(const char* file, FPos filesize);
+        void    cancel();
+
+        bool    running() const                         { return active > 0; }
+        bool    full() const                            { return kept >= (Full) strText; }
+        int     count() const                           { return chunks; }
+        const Chunk& at(int i) const                    { return chunk[i]; }
+}; // end StringIndex
+
+StringIndex stringIndex;
+
+inline bool printable(Byte b)
+{
+        return (b >= ' ' && b < 0x7F) || b == '\t';
+}
+
+//--------------------------------------------------------------------
+// All 8 bytes ' '..'~' (SWAR, tab takes the slow path)
+
+inline bool printable8(Full w)
+{
+        const Full ones = 0x0101010101010101,
+                   high = 0x8080808080808080;
+
+        Full del = w ^ (0x7F * ones);
+
+        return ! ((w | ((w - 0x20 * ones) & ~w) | ((del - ones) & ~del)) & high);
+}
+
+//--------------------------------------------------------------------
+// Start or resume the index, a new file or size begins a new one
+
+void StringIndex::start(const char* file, FPos filesize)
+{
+        if (name != file || size != filesize) {
+                cancel();
+
+                name   = file;
+                size   = filesize;
+                chunks = (size + strChunk - 1) / strChunk;
+                kept   = 0;
+
+                delete [] chunk;
+                chunk = new Chunk[chunks];
+
+                for (int i = 0; i < chunks; ++i) {
+                        chunk[i].done = false;
+                }
+        }
+
+        if (running() || full() || ! chunks || chunk[chunks - 1].done) {
+                return;
+        }
+
+        cancel();  // join the finished
+
+        int count = max<int>(1, min<int>(thread::hardware_concurrency(), mapThreads));
+
+        active = count;
+
+        for (int i = 0; i < count; ++i) {
+                workers.push_back(thread(&StringIndex::work, this));
+        }
+}
+
+void StringIndex::cancel()
+{
+        stop = true;
+
+        for (thread& t : workers) {
+                t.join();
+        }
+
+        workers.clear();
+
+        stop = false;
+        next = 0;
+}
+
+//--------------------------------------------------------------------
+// Worker: claim the next chunk, read it with the bytes around it
+
+void StringIndex::work()
+{
+        File  fd  = OpenFile(name.c_str());
+        Byte *buf = new Byte[strChunk + strMax + 4];
+
+        for (int i; fd >= 0 && ! stop && ! full() && (i = next++) < chunks;) {
+                if (chunk[i].done) {
+                        continue;
+                }
+
+                FPos from = (FPos) i * strChunk,
+                     pos  = max<FPos>(0, from - 2),
+                     end  = min<FPos>(size, from + strChunk + strMax + 2);
+                Size n    = 0;
+
+                for (Size got; pos + n < end; n += got) {
+                        if ((got = pread(fd, buf + n, end - pos - n, pos + n)) <= 0) {
+                                break;
+                        }
+                }
+
+                Chunk& c = chunk[i];
+
+                c.runs.clear();
+                c.text.clear();
+
+                scan(c, buf, n, from - pos, min<FPos>(strChunk, size - from), pos);
+
+                sort(c.runs.begin(), c.runs.end(), [](const Run& a, const Run& b) { return a.off < b.off; });
+
+                if (! stop) {
+                        kept   += c.text.size();
+                        c.done  = true;
+                }
+        }
+
+        delete [] buf;
+
+        if (fd >= 0) {
+                close(fd);
+        }
+
+        --active;
+} // end StringIndex::work
+
+//--------------------------------------------------------------------
+// Runs starting in buf[lead..lead+own), pos is the file offset of buf
+
+void StringIndex::scan(Chunk& c, const Byte* buf, Size n, Size lead, Size own, FPos pos)
+{
+        Size i   = lead,
+             end = min(lead + own, n);
+
+        if (i && printable(buf[i - 1])) {  // the previous chunk has it
+                while (i < n && printable(buf[i])) {
+                        ++i;
+                }
+        }
+
+        while (i < end) {
+                if (! printable(buf[i])) {
+                        i += i + 8 <= n && ! *(const Full*) (buf + i) ? 8 : 1;  // zeros fast
+                        continue;
+                }
+
+                Size st = i;
+
+                while (i < n && i - st < strMax) {
+                        if (i + 8 <= n && i - st + 8 <= strMax && printable8(*(const Full*) (buf + i))) {
+                                i += 8;
+                        }
+                        else if (printable(buf[i])) {
+                                ++i;
+                        }
+                        else {
+                                break;
+                        }
+                }
+
+                if (i - st >= strMin) {
+                        c.runs.push_back({ pos + (FPos) st, (Half) c.text.size(), (Word) (i - st), false });
+                        c.text.append((const char*) buf + st, i - st);
+                }
+
+                while (i < n && printable(buf[i])) {  // cut
+                        ++i;
+                }
+        }
+
+        for (int parity = 0; parity < 2; ++parity) {  // UTF-16LE at even and odd offsets
+                i = lead + ((pos + lead + parity) & 1);
+
+                if (i >= 2 && printable(buf[i - 2]) && ! buf[i - 1]) {
+                        while (i + 1 < n && printable(buf[i]) && ! buf[i + 1]) {
+                                i += 2;
+                        }
+                }
+
+                while (i < end) {
+                        if (i + 1 >= n || buf[i + 1] || ! printable(buf[i])) {
+                                i += 2;
+                                continue;
+                        }
+
+                        Size st = i;
+
+                        while (i + 1 < n && (i - st) / 2 < strMax && printable(buf[i]) && ! buf[i + 1]) {
+                                i += 2;
+                        }
+
+                        if ((i - st) / 2 >= strMin) {
+                                c.runs.push_back({ pos + (FPos) st, (Half) c.text.size(), (Word) ((i - st) / 2), true });
+
+                                for (Size k = st; k < i; k += 2) {
+                                        c.text += buf[k];
+                                }
+                        }
+
+                        while (i + 1 < n && printable(buf[i]) && ! buf[i + 1]) {
+                                i += 2;
+                        }
+                }
+        }
+} // end StringIndex::scan
+
+//====================================================================
+// File signatures  ##:sig
+//
+// Built-in magics plus lines "name hexbytes [offset]" of ~/.vbl-magic.
+// A bitmap of the first two bytes rejects almost every position
+
+struct Signature {
+        string          name;
+        string          magic;
+        Size            at;     // of the magic in the header
+};
+
+deque<Signature> signatures = {
+        { "ELF",      "\x7F" "ELF",                  0 },
+        { "PNG",      "\x89PNG\r\n\x1A\n",           0 },
+        { "JPEG",     "\xFF\xD8\xFF",                 0 },
+        { "GIF",      "GIF8",                         0 },
+        { "PDF",      "%PDF-",                        0 },
+        { "gzip",     "\x1F\x8B\x08",                 0 },
+        { "zip",      "PK\x03\x04",                   0 },
+        { "bzip2",    "1AY&SY",                       4 },
+        { "xz",       "\xFD" "7zXZ",                  0 },
+        { "7z",       "7z\xBC\xAF\x27\x1C",            0 },
+        { "zstd",     "\x28\xB5\x2F\xFD",              0 },
+        { "lz4",      "\x04\x22\x4D\x18",              0 },
+        { "lzma",     string("\x5D\0\0\x80\0", 5),      0 },
+        { "cab",      string("MSCF\0\0\0\0", 8),       0 },
+        { "tar",      "ustar",                        257 },
+        { "squashfs", "hsqs",                         0 },
+        { "cramfs",   "\x45\x3D\xCD\x28",              0 },
+        { "UBI",      "UBI#",                         0 },
+        { "UBIFS",    "\x31\x18\x10\x06",              0 },
+        { "uImage",   "\x27\x05\x19\x56",              0 },
+        { "FDT",      "\xD0\x0D\xFE\xED",              0 },
+        { "ISO9660",  "\x01" "CD001",                 0x8000 },
+        { "NTFS",     "NTFS    ",                     3 },
+        { "btrfs",    "_BHRfS_M",                     0x40 },
+        { "XFS",      "XFSB",                         0 },
+        { "GPT",      "EFI PART",                     0 },
+        { "LUKS",     "LUKS\xBA\xBE",                  0 },
+        { "qcow",     "QFI\xFB",                      0 },
+        { "SQLite",   string("SQLite format 3\0", 16), 0 },
+        { "Mach-O",   "\xCF\xFA\xED\xFE",              0 },
+        { "class",    "\xCA\xFE\xBA\xBE",              0 },
+        { "RIFF",     "RIFF",                         0 },
+        { "Ogg",      "OggS",                         0 },
+};
+
+Byte sigFirst[65536 / 8];  // first two bytes seen
+Size sigSpan;              // longest magic
+
+void initSignatures()
+{
+        if (sigSpan) {
+                return;
+        }
+
+        const char *home = getenv("HOME");
+        FILE *cfg = home ? fopen((string(home) + "/.vbl-magic").c_str(), "r") : NULL;
+
+        for (char line[256], name[64], hex[160]; cfg && fgets(line, sizeof(line), cfg);) {
+                long at = 0;
+
+                if (*line != '#' && sscanf(line, "%63s %159s %li", name, hex, &at) >= 2) {
+                        for (char *pc = hex; *pc; ++pc) {
+                                *pc = upCase(*pc);
+                        }
+
+                        int len = strlen(hex) % 2 ? 0 : packHex(hex);
+
+                        if (len >= 2) {
+                                signatures.push_back({ name, string(hex, len), at });
+                        }
+                }
+        }
+
+        if (cfg) {
+                fclose(cfg);
+        }
+
+        for (const Signature& sig : signatures) {
+                Word key = (Byte) sig.magic[0] | (Byte) sig.magic[1] << 8;
+
+                sigFirst[key >> 3] |= 1 << (key & 7);
+                sigSpan = max<Size>(sigSpan, sig.magic.size());
+        }
+}
+
+//--------------------------------------------------------------------
+// Signatures at buf[from..to), hits as (header offset, signature)
+
+void scanSignatures(const Byte* buf, Size from, Size to, Size len, FPos pos,
+                        vector<pair<FPos, int>>& hits)
+{
+        bool zeros = sigFirst[0] & 1;  // a magic begins with 00 00
+
+        for (Size i = from; i < to; ++i) {
+                if (! zeros && i + 8 <= len && ! *(const Full*) (buf + i)) {
+                        i += 6;  // the last zero may begin a magic 00 xx
+                        continue;
+                }
+
+                Word key = buf[i] | (i + 1 < len ? buf[i + 1] << 8 : 0);
+
+                if (! (sigFirst[key >> 3] & 1 << (key & 7))) {
+                        continue;
+                }
+
+                for (int s = 0; s < (int) signatures.size(); ++s) {
+                        const Signature& sig = signatures[s];
+
+                        if (i + (Size) sig.magic.size() <= len && pos + (FPos) i >= (FPos) sig.at &&
+                                        ! memcmp(buf + i, sig.magic.data(), sig.magic.size())) {
+                                hits.push_back(make_pair(pos + i - sig.at, s));
+                        }
+                }
+        }
+}
+
+//====================================================================
+// Class FileDisplay  ##:file
+
+class Difference;
+
+void getString(char* buf, int maxlen, StrDeq& history,
+                        const char* restrictChar=NULL, bool upcase=false, bool splitHex=false);
+FPos scanPosition(const char* input, Size size, int& rel);
+
+class FileDisplay
+{
+    friend class Difference;
+    friend int   bench(int argc, char* argv[]);
+    friend int   testSearch(const string& path, int round, const vector<const Kernels*>& kernels);
+    friend void  reopen(FileDisplay& f, const string& path);
+    friend void  addView();
+
+        ConWindow               cwinF;
+
+        const Difference       *diffsF;
+
+        char                   *fileName;
+        File                    fd;
+        bool                    editable;
+
+        Byte                   *dataF;
+        chtype                 *rows;  // rendered rows, unchanged ones are skipped
+        FPos                    rowsOff;
+        int                     dataSize;
+        FPos                    offset;
+        FPos                    prevOffset;
+        FPos                    diffOffset;
+        FPos                    lastOffset;
+
+        FPos                   *addr;
+        int                     se4rch;
+        Full                    se4rchMiss;  // bit se4rch-1: byte differs
+        int                     se4rchHow;   // bit shift << 8 | XOR key, +1
+
+        BlockCache             *cache;  // shared with other views of the file
+        FPos                    readOff;
+
+    public:
+        FPos                    searchOff;
+        FPos                    scrollOff;
+        FPos                    repeatOff;
+        FPos                    startAddr;
+        Size                    filesize;
+        Size                    laptime;
+        bool                    two;
+        bool                    view;  // below the pair, no diff
+
+    public:
+               ~FileDisplay();
+
+        bool    setFile(char* FileName);
+        void    initF(int y, const Difference* Diff, bool View=false);
+        void    resizeF();
+        void    place(int y);
+        Command side() const                            { return view ? cmNothing : two ? cmgGotoBottom : cmgGotoTop; }
+        void    dirty()                                 { memset(rows, 0, numLines * screenWidth * sizeof(chtype)); rowsOff = -1; }
+        void    updateF()                               { cwinF.updateW(); }
+        void    flush()                                 { cache = BlockCache::attach(fd, cache); }
+        int     readKeyF()                              { return cwinF.readKeyW(); }
+        int     peekKeyF()                              { return cwinF.peekKeyW(); }
+
+        void    display();
+        void    busy(bool on, bool ic);
+        void    highEdit(short count);
+
+        void    edit(const FileDisplay* other, bool keep=false);
+        void    replace(const Byte* searchFor, Size searchLen, const Byte* with, Size withLen,
+                        const FileDisplay* other);
+        void    overwrite(const Byte* searchFor, Size len, const Byte* with);
+        void    editOut(FPos top, FPos from=-1, FPos to=-1);
+        void    range(const FileDisplay* other, FPos lo, Size len);
+        bool    commit(PieceTable& pt);
+        bool    saveAs(PieceTable& pt, const char* path);
+        bool    WriteTail(Journal& jr);
+        int     recover(Journal& jr, const char* title);
+        void    resume();
+        bool    assure(Size diff);
+        void    progress1();
+        void    progress(wchar_t* bar, int count, int delay, int stint);
+        Size    finish(int init);
+
+        void    setLast()                               { lastOffset = offset; }
+        void    getLast()                               { FPos tmp = offset; moveTo(lastOffset); lastOffset = tmp; }
+        void    skip(bool upwards);
+        void    sync(const FileDisplay* other);
+        void    reread(const FileDisplay& other);
+        bool    grow();
+        void    watch()                                 { if (fd) inotify_add_watch(followFd, fileName, IN_MODIFY); }
+
+        void    move(FPos step)                         { moveTo(offset + step); }
+        void    moveTo(FPos newOffset);
+        void    moveToEnd()                             { moveTo(filesize - steps[cmmMovePage]); }
+        void    moveForw(const Byte* searchFor, Size searchLen);
+        void    moveBack(const Byte* searchFor, Size searchLen);
+        void    moveScan(Size size, bool back, const function<FPos(Byte*, Size)>& scan);
+        void    moveValue(const ValueQuery& q, bool back);
+        void    moveFuzzy(const Byte* searchFor, Size searchLen, int k, bool back);
+        void    moveBits(const Byte* searchFor, Size searchLen, int mode, bool back);
+
+        void    seekNotChar(bool upwards);
+        void    smartScroll();
+        FPos    showMap();
+        FPos    showStrings();
+        FPos    carve();
+        void    checksum(const FileDisplay* other);
+}; // end FileDisplay
+
+//====================================================================
+// Class Difference
+
+class Difference
+{
+    friend void FileDisplay::display();
+
+    protected:
+        Byte           *dataD;
+        FileDisplay    *file1D;
+        FileDisplay    *file2D;
+
+    public:
+                Difference(FileDisplay* File1, FileDisplay* File2):
+                                        file1D(File1), file2D(File2)  {}
+               ~Difference()                                            { delete [] dataD; }
+        void    resizeD();
+        int     compute(Command cmd);
+        void    speedup(int way);
+}; // end Difference
+
+//====================================================================
+// Object instantiation
+
+FileDisplay     file1, file2;
+
+vector<FileDisplay*> views;  // more views below, each with its own offset
+
+PieceTable      edits;
+
+Difference      diffs(&file1, &file2);
+
+//====================================================================
+// Class Difference member functions
+
+void Difference::resizeD()
+{
+        delete [] dataD;
+
+        dataD = new Byte[bufSize];
+}
+
+//--------------------------------------------------------------------
+// Compute differences  ##:u
+
+int Difference::compute(Command cmd)
+{
+        haveDiff = 0;
+        memset(dataD, 0, bufSize);
+
+        if (! file1D->dataSize) {
+                file1.moveToEnd();
+        }
+
+        if (! file2D->dataSize) {
+                file2.moveToEnd();
+        }
+
+        const Byte *buf1 = file1D->dataF,
+                   *buf2 = file2D->dataF;
+
+        int size = min(file1D->dataSize, file2D->dataSize);
+
+        int diff = size;
+
+        haveDiff = kernel.diff(buf1, buf2, dataD, size);
+
+        size = max(file1D->dataSize, file2D->dataSize);
+
+        for (; diff < size; ++diff) {
+                dataD[diff] = true;
+                haveDiff++;
+        }
+
+        if (cmd == cmPrevDiff && (! file1D->offset || ! file2D->offset)) {
+                return 1;
+        }
+
+        if (cmd == cmNextDiff && (file1D->dataSize < bufSize || file2D->dataSize < bufSize)) {
+                haveDiff = -1;  // move anyway
+        }
+
+        return haveDiff;
+} // end Difference::compute
+
+//--------------------------------------------------------------------
+// Speedup differ - diff in next/prev staticSize bytes
+
+void Difference::speedup(int way)
+{
+        if (way > 0) {
+                SeekFile(file1D->fd, file1D->offset);
+                SeekFile(file2D->fd, file2D->offset);
+
+                while (file1D->offset + staticSize < file1.filesize &&
+                                file2D->offset + staticSize < file2.filesize && ! stopRead) {
+                        ReadFile(file1D->fd, bufFile1, staticSize);
+                        ReadFile(file2D->fd, bufFile2, staticSize);
+
+                        if (memcmp(bufFile1, bufFile2, staticSize)) {
+                                break;
+                        }
+
+                        file1D->offset += staticSize;
+                        file2D->offset += staticSize;
+                }
+        }
+        else {  // downwards
+                while (file1D->offset - staticSize > 0 &&
+                                file2D->offset - staticSize > 0 && ! stopRead) {
+                        SeekFile(file1D->fd, file1D->offset - staticSize);
+                        SeekFile(file2D->fd, file2D->offset - staticSize);
+
+                        ReadFile(file1D->fd, bufFile1, staticSize);
+                        ReadFile(file2D->fd, bufFile2, staticSize);
+
+                        if (memcmp(bufFile1, bufFile2, staticSize)) {
+                                break;
+                        }
+
+                        file1D->offset -= staticSize;
+                        file2D->offset -= staticSize;
+                }
+        }
+} // end Difference::speedup
+
+//====================================================================
+// Class FileDisplay member functions
+
+FileDisplay::~FileDisplay()
+{
+        if (fd) {
+                close(fd);
+        }
+
+        delete [] dataF;
+        delete [] rows;
+        if (cache) {
+                BlockCache::detach(cache);
+        }
+
+        free(addr);
+}
+
+//--------------------------------------------------------------------
+// Open a file for display
+
+bool FileDisplay::setFile(char* FileName)
+{
+        fileName = FileName;
+
+        File probe = OpenFile(fileName, true);
+
+        if (probe > 0) {
+                editable = true;
+                close(probe);
+        }
+
+        if ((fd = OpenFile(fileName)) < 0) {
+                return false;
+        }
+
+        if ((filesize = SeekFile(fd, 0, SEEK_END)) < 0) {
+                return false;
+        }
+
+        if (filesize > 68719476736) {  // 2**30*64 == 0x10**9 == 64GB
+                sizeTera = true;
+        }
+
+        SeekFile(fd, 0);
+
+        return true;
+} // end FileDisplay::setFile
+
+void FileDisplay::resizeF()
+{
+        delete [] dataF;
+        delete [] rows;
+
+        dataF = new Byte[bufSize];
+        rows  = new chtype[numLines * screenWidth];
+
+        cwinF.resizeW(screenWidth, numLines + 1);
+
+        dirty();
+}
+
+//--------------------------------------------------------------------
+// Move to another place on screen, rows as many as fit now
+
+void FileDisplay::place(int y)
+{
+        cwinF.placeW(y, screenWidth, numLines + 1);
+
+        resizeF();
+
+        free(addr);
+        addr = (FPos*) calloc(numLines, sizeof(FPos));
+
+        move(0);
+}
+
+//--------------------------------------------------------------------
+// Set member variables
+
+void FileDisplay::initF(int y, const Difference* Diff, bool View)
+{
+        diffsF = Diff;
+        view = View;
+        two = y && ! view;
+
+        cwinF.initW(0, y, screenWidth, numLines + 1, cMainWin);
+
+        flush();
+
+        resizeF();
+
+        moveTo(startAddr);
+
+        addr = (FPos*) calloc(numLines, sizeof(FPos));
+}
+
+//--------------------------------------------------------------------
+// Display the file contents  ##:disp
+
+void FileDisplay::display()
+{
+        if (! fd) {
+                return;
+        }
+
+        short first,
+              last,
+              row,
+              col,
+              lineLength;
+
+        FPos lineOffset = offset;
+
+        if (scrollOff) {
+                diffOffset = scrollOff - offset;
+        }
+        else if (offset != prevOffset) {
+                diffOffset = offset - prevOffset;
+
+                prevOffset = offset;
+        }
+
+        Byte pos = (scrollOff ? scrollOff + lineWidth : offset + bufSize)
+                        * 100
+                        / (filesize > bufSize ? filesize : bufSize);
+
+        char bufStat[screenWidth + 1] = { 0 };
+        memset(bufStat, ' ', screenWidth);
+
+        char buf[96 + screenWidth],
+             buf2[3][48] = { "", "", "" };
+
+        if (se4rch && se4rchHow) {  // how the last hit was found
+                sprintf(buf2[2], " <<%d ^%02X", (se4rchHow - 1) >> 8, (se4rchHow - 1) & 0xFF);
+        }
+
+        sprintf(buf, "%s %s %s %d%% %s %s%s",
+                buf2[2],
+                pretty(buf2[0], &offset, 0),
+                pretty(buf2[1], &diffOffset, 1),
+                pos > 100 ? 100 : pos,
+                ignoreCase ? "I" : "i",
+                editable ? "RW" : "RO",
+                followFd < 0 ? "" : " F");
+
+        if (showMetrics && ! two && ! view && lastOp >= 0) {  // overlay, as far as it fits
+                char over[96];
+                int  room = screenWidth - 8 - strlen(buf);
+
+                if (room > 0) {
+                        string line = string(metricText(over)).substr(0, room) + buf;
+
+                        strcpy(buf, line.c_str());
+                }
+        }
+
+        short size_name = screenWidth - strlen(buf),
+              size_fname = strlen(fileName);
+
+        if (size_fname <= size_name) {
+                memcpy(bufStat, fileName, size_fname);
+        }
+        else {
+                first = size_name / 4;
+
+                memcpy(bufStat, fileName, first);
+                memcpy(bufStat + first, " ... ", 5);
+
+                last = size_name - first - 5;
+
+                memcpy(bufStat + first + 5, fileName + size_fname - last, last);
+        }
+
+        memcpy(bufStat + size_name, buf, strlen(buf));
+
+        cwinF.put(0, 0, bufStat);
+        cwinF.putAttribs(0, 0, cName, strlen(bufStat));
+
+        if (view) {
+                if (viewFocus && views[viewFocus - 1] == this) {
+                        cwinF.putAttribs(0, 0, cHighFile, size_name);
+                }
+        }
+        else if (lockState == lockBottom && ! two) {
+                cwinF.putAttribs(0, 0, cHighFile, size_name);
+        }
+        else if (lockState == lockTop && two) {
+                cwinF.putAttribs(0, 0, cHighFile, size_name);
+        }
+
+        if (diffOffset < 0) {
+                char *pc = (char*) memchr(buf, '-', strlen(buf));
+
+                cwinF.putAttribs(size_name + (pc - buf), 0, cSearch, 1);
+        }
+
+        char   text[screenWidth];
+        Style  attr[screenWidth];
+        chtype line[screenWidth];
+
+        Size   rowSize = screenWidth * sizeof(chtype);
+        FPos   shift   = (offset - rowsOff) / lineWidth;
+
+        if (rowsOff >= 0 && ! scrollOff && (offset - rowsOff) % lineWidth == 0 && shift && abs(shift) < numLines) {
+                cwinF.scrollW(1, numLines, shift);  // line moves
+
+                if (shift > 0) {
+                        memmove(rows, rows + shift * screenWidth, (numLines - shift) * rowSize);
+                        memset(rows + (numLines - shift) * screenWidth, 0, shift * rowSize);
+                }
+                else {
+                        memmove(rows - shift * screenWidth, rows, (numLines + shift) * rowSize);
+                        memset(rows, 0, -shift * rowSize);
+                }
+        }
+
+        rowsOff = scrollOff ? -1 : offset;
+
+        short wAddr = sizeTera ? 12 : 9;
+
+        for (row=0; row < numLines; ++row) {
+                memset(text, ' ', screenWidth);
+
+                for (col=0; col < screenWidth; ++col) {
+                        attr[col] = cMainWin;
+                }
+
+                if (*(addr + row)) {
+                        lineOffset += (lineWidth * (*(addr + row)));
+                }
+
+                FPos digits = lineOffset;
+
+                for (col = wAddr - 1; col >= 0; --col, digits >>= 4) {
+                        text[col] = hexDigits[digits & 0x0F];
+                }
+
+                lineLength = min(lineWidth, dataSize - row * lineWidth);
+
+                const Byte *data = dataF + row * lineWidth;
+                char *pHex = text + leftMar,
+                     *pAsc = text + (modeAscii ? leftMar : leftMar2);
+
+                for (col=0; col < lineLength; ++col) {
+                        if (! modeAscii) {
+                                memcpy(pHex + col * 3, hexLUT[data[col]], 3);
+                        }
+
+                        pAsc[col] = ascLUT[modeAscii][data[col]];
+                }
+
+                for (col=0; col < (sizeTera ? 11 : 8); ++col) {
+                        if (text[col] != '0') {
+                                break;
+                        }
+                }
+                paint(attr, col, cAddress, wAddr - col);
+
+                if (showRaster) {
+                        if (sizeTera) {
+                                paint(attr, 0, cRaster, 1);
+                        }
+                        paint(attr, sizeTera ? 4 : 1, cRaster, 1);
+                        paint(attr, sizeTera ? 8 : 5, cRaster, 1);
+                }
+
+                if (! modeAscii && showRaster && lineLength > 0) {
+                        for (col=0; col <= lineWidth - 8; col += 8) {
+                                paint(attr, leftMar  + col * 3 - 1, cRaster, 1);
+                                paint(attr, leftMar2 + col        , cRaster, 1);
+                        }
+                }
+
+                if (haveDiff && diffsF) {  // views show no diff
+                        for (col=0; col < lineWidth; ++col) {
+                                if (diffsF->dataD[row * lineWidth + col]) {
+                                        paint(attr, leftMar  + col * 3, cDiff, 2);
+                                        paint(attr, leftMar2 + col    , cDiff, 1);
+                                }
+                        }
+                }
+
+                if (se4rch && row >= (searchOff >= searchIndent ? searchIndent / lineWidth : 0)) {
+                        for (col=0; se4rch && col < lineWidth; --se4rch, ++col) {
+                                Style hue = se4rch <= 64 && se4rchMiss >> (se4rch - 1) & 1 ? cDiff : cSearch;
+
+                                if (modeAscii) {
+                                        paint(attr, leftMar  + col    , hue, 1);
+                                }
+                                else {
+                                        paint(attr, leftMar  + col * 3, hue, 2);
+                                        paint(attr, leftMar2 + col    , hue, 1);
+                                }
+                        }
+
+                        if (! se4rch) {
+                                se4rchMiss = 0;
+                                se4rchHow  = 0;
+                        }
+                }
+
+                if (*(addr + row)) {
+                        for (col=0; col < lineWidth; ++col) {
+                                if (modeAscii) {
+                                        paint(attr, leftMar  + col    , cDiff, 1);
+                                }
+                                else {
+                                        paint(attr, leftMar  + col * 3, cDiff, 2);
+                                        paint(attr, leftMar2 + col    , cDiff, 1);
+                                }
+                        }
+                }
+
+                for (col=0; col < screenWidth; ++col) {  // one call per row
+                        line[col] = (Byte) text[col] | attribStyle[attr[col]];
+                }
+
+                chtype *cache = rows + row * screenWidth;
+
+                if (memcmp(cache, line, rowSize)) {
+                        memcpy(cache, line, rowSize);
+
+                        cwinF.putLine(row + 1, line, screenWidth);
+                }
+
+                lineOffset += lineWidth;
+        }
+
+        if (scrollOff) {
+                moveTo(offset);  // reload buffer
+
+                memset(addr, 0, numLines * sizeof(FPos));
+        }
+
+        updateF();
+} // end FileDisplay::display
+
+//--------------------------------------------------------------------
+// Busy status
+
+void FileDisplay::busy(bool on=false, bool ic=false)
+{
+        if (on) {
+                cwinF.putAttribs(screenWidth - (ic ? 4 : 2),  0, cHighBusy, ic ? 1 : 2);
+                updateF();
+        }
+        else {
+                nap(150);
+                cwinF.putAttribs(screenWidth - (ic ? 4 : 2),  0, cName, ic ? 1 : 2);
+
+                if (! singleFile && ! two) {
+                        updateF();
+                }
+        }
+}
+
+//--------------------------------------------------------------------
+// Highlight statusbar
+
+void FileDisplay::highEdit(short count)
+{
+        cwinF.putAttribs(0, 0, cHighEdit, count);
+}
+
+//--------------------------------------------------------------------
+// Display the edited file  ##:out
+
+void FileDisplay::editOut(FPos top, FPos from, FPos to)
+{
+        FPos lineOffset = top;
+
+        Byte bytes[bufSize],
+             style[bufSize];
+
+        int size = edits.read(top, bytes, bufSize, style);
+
+        char bufHex[screenWidth + 1] = { 0 },
+             bufAsc[  lineWidth + 1] = { 0 };
+
+        for (int row=0; row < numLines; ++row) {
+                memset(bufHex, ' ', screenWidth);
+                memset(bufAsc, ' ',   lineWidth);
+
+                char *pbufHex = bufHex;
+
+                pbufHex += sprintf(pbufHex, "%0*lX  ", sizeTera ? 12 : 9, lineOffset);
+
+                int lineLength = min(lineWidth, size - row * lineWidth);
+
+                for (int col=0; col < lineLength; ++col) {
+                        Byte b = bytes[row * lineWidth + col];
+
+                        pbufHex += sprintf(pbufHex, "%02X ", b);
+
+                        bufAsc[col] = isprint(b) ? b : '.';
+                }
+                *pbufHex = ' ';
+
+                cwinF.put(0,        row + 1, bufHex);
+                cwinF.put(leftMar2, row + 1, bufAsc);
+
+                if (showRaster) {
+                        int col[] = { 0, 1, 4, 5, 8 };
+
+                        for (int i = sizeTera ? 0 : 1; i < 5; i += 2) {
+                                cwinF.putAttribs(col[i], row + 1, cRaster, 1);
+                        }
+                }
+
+                if (showRaster && bufHex[leftMar] != ' ') {
+                        for (int col=0; col <= lineWidth - 8; col += 8) {
+                                cwinF.putAttribs(leftMar  + col * 3 - 1, row + 1, cRaster, 1);
+                                cwinF.putAttribs(leftMar2 + col        , row + 1, cRaster, 1);
+                        }
+                }
+
+                for (int c, col=0; col < lineLength; ++col) {
+                        FPos pos = lineOffset + col;
+
+                        if ((c = pos >= from && pos <= to ? (int) cSearch : style[row * lineWidth + col])) {  // marked range
+                                cwinF.putAttribs(leftMar  + col * 3, row + 1, (Style) c, 2);
+                                cwinF.putAttribs(leftMar2 + col    , row + 1, (Style) c, 1);
+                        }
+                }
+
+                lineOffset += lineWidth;
+        }
+} // end FileDisplay::editOut
+
+//--------------------------------------------------------------------
+// Obtain confirmation for lengthy write
+
+bool FileDisplay::assure(Size diff)
+{
+        bool ret = true;
+
+        if (diff > warnResize) {
+                char str[96],
+                     inp[4];
+
+                sprintf(str, " About to write %.1fGB (Esc interrupts)!? {yes|no}: ", (double) diff / 1073741824);
+
+                echo();
+                for (;;) {
+                        positionInWin(side(), 1+ strlen(str) +5+1, " Attention! ", 5);
+
+                        mvwaddstr(winInput, 2, 1, str);
+
+                        wgetnstr(winInput, inp, 3);
+
+                        if (! strcmp(inp, "yes")) {
+                                break;
+                        }
+
+                        else if (! strcmp(inp, "no")) {
+                                ret = false;
+                                break;
+                        }
+                }
+                noecho();
+        }
+        updateF();
+        hideCursor();
+
+        return ret;
+} // end FileDisplay::assure
+
+//--------------------------------------------------------------------
+// Progress bar single
+
+void FileDisplay::progress1()
+{
+        int blocks = 25,
+            delay  = 4;
+
+        hideCursor();
+        positionInWin(side(), 2+ blocks +2, "");
+
+        wchar_t bar[blocks + 1];
+        memset(bar, 0, sizeof(bar));
+
+        for (int i=0; i < blocks; ++i) {
+                for (int j=0; j < 8; ++j) {
+                        bar[i] = barSyms[j];
+
+                        mvwaddwstr(winInput, 1, 2, bar);
+                        refreshW(winInput);
+                        nap(delay);
+                }
+        }
+        nap(250);
+}
+
+//--------------------------------------------------------------------
+// Progress bar multiple
+
+void FileDisplay::progress(wchar_t* bar, int count, int delay, int stint=1)
+{
+        int pos = count * stint / 8,
+            sym = count * stint % 8;
+
+        for (int i=0; i < stint; ++i) {
+                bar[pos] = barSyms[sym % 8];
+
+                if (! (++sym % 8)) {
+                        ++pos;
+                }
+
+                mvwaddwstr(winInput, 1, 2, bar);
+                refreshW(winInput);
+
+                if (delay) {
+                        nap(delay);
+                }
+        }
+}
+
+//--------------------------------------------------------------------
+// Progress bar end (or debug profiling)
+
+Size FileDisplay::finish(int init=0)
+{
+        if (init) {
+                laptime = clockNs(CLOCK_TAI);
+
+                return 0;
+        }
+
+        return clockNs(CLOCK_TAI) - laptime;
+}
+
+//--------------------------------------------------------------------
+// Run the write plan: shift the remainder, then patch
+
+bool FileDisplay::WriteTail(Journal& jr)
+{
+        Measure measure(opWrite);
+
+        if (! jr.settle(fd)) {
+                return false;
+        }
+
+        Size remain = jr.remain();
+
+        int width = (screenWidth - 4) * 8,
+            level = (screenWidth / 3) * 8,
+            cargo = staticSize,
+            loops = remain / cargo,
+            scale = 0,
+            delay = 4,
+            count = 0,
+            stage = 0,
+            tally = 0,
+            final = 0;
+
+        Size round = 0,
+             chunk = 0;
+
+        if (! loops) {
+                progress1();
+        }
+
+        else if (loops > width) {
+                scale = loops / width + (loops % width ? 1 : 0);
+                width = loops / scale + (loops % scale ? 1 : 0);
+        }
+
+        else if (loops > level) {
+                width = loops;
+        }
+
+        else {
+                cargo = remain / level >> 12;
+                cargo *= 4096;  // page align
+
+                width = remain / cargo;
+        }
+
+        stage = width - 8;
+
+        width = width / 8 + (width % 8 ? 1 : 0);
+
+        wchar_t bar[width + 1];
+        memset(bar, 0, sizeof(bar));
+
+        if (loops) {
+                positionInWin(side(), 2+ width +2, "");
+        }
+
+#if SHOW_WRITE_SUMMARY
+        int term = time(NULL);
+#endif
+        jr.stopped = false;
+
+        FPos size = SeekFile(fd, 0, SEEK_END);
+
+        for (Size len; size < jr.newSize; size += len) {  // check
+                len = min((Size) staticSize, jr.newSize - size);
+
+                SeekFile(fd, size);
+                if (! WriteFile(fd, buffer, len)) {
+                        return false;
+                }
+        }
+
+        if (jr.other.size() && jr.ofd < 0) {
+                jr.ofd = OpenFile(jr.other.c_str());
+        }
+
+        while (jr.step < (Size) jr.plan.size()) {
+                JournalStep st = jr.plan[jr.step];
+
+                bool upwards = st.kind == stepMove && st.dst > st.src;
+                Size delta   = upwards ? st.dst - st.src : st.src - st.dst,
+                     tile    = staticSize - staticSize % max(st.arg, (Size) 1);
+
+                for (Size i=0; st.kind == stepFill && i < tile; ++i) {  // pattern aligned
+                        bufFile2[i] = jr.patch[st.src + i % st.arg];
+                }
+
+                Size group = 0;  // end of the chunks kept by the last mark
+
+                while (jr.done < st.len) {
+                        Size len = min((Size) cargo, st.len - jr.done);
+                        FPos rel = upwards ? st.len - jr.done - len : jr.done;
+
+                        const Byte *src = buffer;
+
+                        if (mScale > stage) {  // use only the last ones for timekeeping
+                                finish(1);
+                        }
+
+                        if (st.kind == stepMove) {
+                                bool fresh = jr.done >= group;  // else saved with the group
+
+                                if (fresh && delta < len) {  // overlap: save what the next chunks overwrite
+                                        group = jr.done + min((Size) jrnlGroup / cargo * cargo, st.len - jr.done);  // whole chunks
+
+                                        if (! jr.keep(fd, group - jr.done)) {
+                                                return false;
+                                        }
+                                }
+
+                                else if (fresh && (jr.done + len - delta > jr.marked || jr.done - jr.marked >= jrnlSpan ||
+                                                  time(NULL) - jr.markTime >= jrnlSecs)) {
+                                        if (! jr.mark(fd)) {  // source ahead gets overwritten
+                                                return false;
+                                        }
+                                }
+
+                                SeekFile(fd, st.src + rel);
+                                if (ReadFile(fd, buffer, len) != len) {
+                                        return false;
+                                }
+                        }
+                        else if (st.kind == stepPatch) {
+                                src = (const Byte*) jr.patch.data() + st.src + rel;
+                        }
+
+                        else if (st.kind == stepCopy) {
+                                if (! CopyRange(jr.ofd, st.src + rel, fd, st.dst + rel, len)) {
+                                        return false;
+                                }
+                                src = NULL;
+                        }
+
+                        else {  // fill: zeros are allocated, else pattern-aligned parts
+                                if (st.arg > 1 || bufFile2[0] ||
+                                    fallocate(fd, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE, st.dst + rel, len) == ERR) {
+                                        for (Size n=0, part; n < len; n += part) {
+                                                part = min(len - n, tile - st.arg);
+
+                                                if (WriteAt(fd, bufFile2 + (rel + n) % st.arg, part, st.dst + rel + n) != part) {
+                                                        return false;
+                                                }
+                                        }
+                                }
+                                src = NULL;
+                        }
+
+                        if (src) {
+                                SeekFile(fd, st.dst + rel);
+                                if (! WriteFile(fd, src, len)) {
+                                        return false;
+                                }
+                        }
+
+                        jr.done += len;
+
+                        if (mScale > stage) {
+                                round += finish() + 1;  // assure non-zero
+                        }
+
+                        if (st.kind != stepMove) {  // a move has polled in ReadFile
+                                PollEscape();
+                        }
+
+                        if (stopRead) {
+                                jr.stopped = true;
+                                jr.mark(fd);
+
+                                return false;
+                        }
+
+                        if (len < cargo) {
+                                continue;
+                        }
+
+                        if (scale && count % scale) {
+                                count++;
+                                continue;
+                        }
+
+                        if (round) {
+                                if (! scale || tally++) {  // discard single round
+                                        chunk += round;
+                                        final++;
+                                }
+
+                                round = 0;
+                        }
+
+                        progress(bar, mScaleInc, delay);
+                }
+
+                ++jr.step;
+                jr.done = 0;
+
+                if (! jr.mark(fd)) {
+                        return false;
+                }
+        }
+
+        if (jr.newSize < size && ftruncate(fd, jr.newSize) == ERR) {
+                return false;
+        }
+
+        if (fdatasync(fd) == ERR) {
+                return false;
+        }
+
+        jr.remove();
+
+#if SHOW_WRITE_SUMMARY
+        if (remain > warnResize) {
+                term = time(NULL) - term;
+
+                sprintf(bufTimer, "  %dsec (%.1fmin)  %ldMByte/s  ",
+                        term,
+                        (float) term / 60,
+                        remain / 1048576 / (term ? term : 1));
+        }
+#endif
+        if (loops) {
+                for (;;) {
+                        if (scale && count % scale) {
+                                ++count;
+                        }
+
+                        else if (mScale % 8) {  // neat finish
+                                progress(bar, mScaleInc, chunk / (final ? final : 1) / 1000000 + delay);
+                        }
+
+                        else {
+                                break;
+                        }
+                }
+                nap(600);
+        }
+
+        return true;
+} // end FileDisplay::WriteTail
+
+//--------------------------------------------------------------------
+// Resume or undo an interrupted write  ##:rec
+//
+// returns 1 written, -1 undone, 0 left for later
+
+int FileDisplay::recover(Journal& jr, const char* title)
+{
+        for (;;) {
+                hideCursor();
+                positionInWin(side(), 1+ 30 +1, title, 5);
+
+                bool undo = ! jr.reverse && ! jr.lossy;
+
+                mvwaddstr(winInput, 2, 1, jr.reverse ? "  R Resume undo     L Later   " :
+                                          jr.lossy   ? "  R Resume          L Later   "
+                                                     : "  R Resume  U Undo  L Later   ");
+
+                mvwchgat(winInput, 2,  3, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                mvwchgat(winInput, 2, undo ? 13 : 21, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+
+                if (undo) {
+                        mvwchgat(winInput, 2, 21, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                }
+
+                int key = upCase(getKey(winInput));
+
+                stopRead = false;
+
+                if (key == 'R') {
+                        if (WriteTail(jr)) {
+                                return jr.reverse ? -1 : 1;
+                        }
+                }
+
+                else if (key == 'U' && undo) {
+                        if (jr.rollback(fd) && WriteTail(jr)) {
+                                return -1;
+                        }
+                }
+
+                else if (key == 'L') {
+                        return 0;
+                }
+
+                title = jr.stopped ? " Interrupted " : " Write failed ";
+
+                flushinp();
+        }
+} // end FileDisplay::recover
+
+//--------------------------------------------------------------------
+// Journal of a previous run found
+
+void FileDisplay::resume()
+{
+        Journal jr(fileName);
+
+        if (! jr.load()) {
+                return;
+        }
+
+        File rw = OpenFile(fileName, true);
+
+        if (rw < 0) {
+                return;
+        }
+
+        close(fd);
+        fd = rw;
+
+        recover(jr, jr.reverse ? " Interrupted undo found " : " Interrupted write found ");
+
+        close(fd);
+        fd = OpenFile(fileName);
+
+        filesize = SeekFile(fd, 0, SEEK_END);
+        flush();
+
+        move(0);
+} // end FileDisplay::resume
+
+//--------------------------------------------------------------------
+// Edit the file  ##:edit
+
+void FileDisplay::edit(const FileDisplay* other, bool keep)
+{
+        if (! editable) {
+                return;
+        }
+
+        bool hiNib = true,
+             ascii = false;
+
+        FPos top  = offset,
+             cur  = offset,
+             mark = -1,
+             end;
+
+        int key;
+
+        if (! keep) {
+                edits.init(fd, filesize);
+        }
+        const FileDisplay *source = other && other->cache != cache ? other : NULL;  // the same file would be shifted first
+
+        edits.link(source ? source->fd : -1, source ? source->fileName : NULL);
+
+again:
+        showCursor();
+
+        for (;;) {
+                end = edits.size ? edits.size - 1 : 0;
+
+                if (cur > end) {
+                        cur = end;
+                }
+
+                if (cur < top) {  // scroll
+                        top -= (top - cur + lineWidth - 1) / lineWidth * lineWidth;
+
+                        if (top < 0) {
+                                top = 0;
+                        }
+                }
+
+                else if (cur >= top + bufSize) {
+                        top += (cur - top - bufSize) / lineWidth * lineWidth + lineWidth;
+                }
+
+                if (mark < 0) {
+                        editOut(top);
+                }
+                else {
+                        editOut(top, min(mark, cur), max(mark, cur));
+                }
+
+                int x = (cur - top) % lineWidth,
+                    y = (cur - top) / lineWidth;
+
+                cwinF.setCursor((ascii ? leftMar2 + x : leftMar + 3 * x + ! hiNib), y + 1);
+
+                key = readKeyF();
+
+                switch (key) {
+                        case KEY_ESCAPE:
+                                goto done;
+
+                        case KEY_TAB:
+                                hiNib  = true;
+                                ascii ^= true;
+                                break;
+
+                        case KEY_IC: {
+                                Byte b = ascii ? ' ' : '\0';
+
+                                edits.insert(cur, &b, 1);
+                                break;
+                        }
+
+                        case KEY_DC:
+                                edits.erase(cur, 1);
+                                break;
+
+                        case KEY_CTRL_B:
+                                edits.undo();
+                                break;
+
+                        case KEY_CTRL_F:
+                                edits.redo();
+                                break;
+
+                        case KEY_CTRL_L:
+                                mark = mark < 0 ? cur : -1;
+                                break;
+
+                        case KEY_CTRL_G: {
+                                positionInWin(side(), inWidth + 1 + 4, " Goto ");
+
+                                char buf[inWidth + 1];
+
+                                getString(buf, inWidth, positionHistory, hexDigitsGoto);
+
+                                if (*buf) {
+                                        int  rel;
+                                        FPos pos = scanPosition(buf, edits.size, rel);
+
+                                        cur   = rel ? max(cur + rel * pos, (FPos) 0) : pos;
+                                        top   = cur - cur % lineWidth;
+                                        hiNib = true;
+                                }
+                                showCursor();
+                                break;
+                        }
+
+                        case KEY_CTRL_R:
+                                if (mark >= 0) {
+                                        range(source, min(mark, cur), abs(cur - mark) + 1);
+
+                                        mark = -1;
+                                        showCursor();
+                                }
+                                break;
+
+                        case KEY_HOME:
+                                hiNib = true;
+                                cur   = top;
+                                break;
+
+                        case KEY_END:
+                                cur = top + bufSize - 1;
+                                break;
+
+                        case KEY_PPAGE:
+                                top -= min(top, (FPos) steps[cmmMovePage]);
+                                cur -= min(cur, (FPos) steps[cmmMovePage]);
+                                break;
+
+                        case KEY_NPAGE:
+                                if (top + steps[cmmMovePage] <= end) {
+                                        top += steps[cmmMovePage];
+                                        cur += steps[cmmMovePage];
+                                }
+                                break;
+
+                        case KEY_UP:
+                                if (cur >= lineWidth) {
+                                        cur -= lineWidth;
+                                }
+                                break;
+
+                        case KEY_DOWN:
+                                if (cur + lineWidth <= end) {
+                                        cur += lineWidth;
+                                }
+                                break;
+
+                        case KEY_LEFT:
+                                if (! hiNib) {
+                                        hiNib = true;
+                                }
+
+                                else if (cur) {
+                                        hiNib = ascii;
+                                        --cur;
+                                }
+                                break;
+
+                        default: {
+                                short newByte = -1;
+
+                                if (key == KEY_RETURN && other) {
+                                        FPos pos = other->offset + cur - offset;
+                                        Byte b;
+
+                                        if (pos >= 0 && ReadAt(other->fd, &b, 1, pos) == 1) {
+                                                newByte = b;
+
+                                                hiNib = false;  // advance
+                                        }
+                                }
+
+                                else if (ascii && isprint(key)) {
+                                        newByte = key;
+                                }
+
+                                else {
+                                        if (isxdigit(key)) {
+                                                newByte = upCase(key) - (isdigit(key) ? 48 : 55);
+
+                                                if (hiNib) {
+                                                        newByte <<= 4;
+                                                }
+
+                                                newByte |= edits.at(cur) & (hiNib ? 0x0F : 0xF0);
+                                        }
+                                }
+
+                                if (newByte < 0) {
+                                        break;
+                                }
+
+                                edits.replace(cur, newByte);
+                        }  // fall thru
+
+                        case KEY_RIGHT:
+                                if (hiNib && ! ascii) {
+                                        hiNib = false;
+                                        break;
+                                }
+
+                                hiNib = true;
+
+                                if (cur < end) {
+                                        ++cur;
+                                }
+                }
+        }
+
+done:
+        hideCursor();
+
+        dirty();  // rows were overwritten
+
+        if (! edits.changed()) {
+                return;
+        }
+
+        if (! sizeTera && edits.size > 68719476736) {  // very special case
+                positionInWin(side(), 1+ 14 +1, "", 5);
+
+                mvwaddstr(winInput, 2, 1, "  File >64GB  ");
+                getKey(winInput);
+                return;
+        }
+
+        positionInWin(side(), 1+ 21 +3+1, "");
+
+        mvwaddstr(winInput, 1, 1, " Save changes [y/a]: ");
+
+        key = getKey(winInput);
+
+        if (upCase(key) == 'A') {
+                positionInWin(side(), screenWidth, " Save As ");
+
+                int maxlen = screenWidth - 4 - 1;
+                char buf[maxlen + 1];
+
+                getString(buf, maxlen, fileNameHistory);
+
+                if (*buf && ! saveAs(edits, buf)) {
+                        goto again;  // edits kept, try again
+                }
+                return;
+        }
+
+        if (upCase(key) != 'Y') {
+                return;
+        }
+
+        wechochar(winInput, key);
+        nap(500);
+
+        if (! commit(edits) && edits.changed()) {
+                goto again;
+        }
+} // end FileDisplay::edit
+
+//--------------------------------------------------------------------
+// Replace all matches, review them in edit mode  ##:repl
+//
+// One pass with the search kernel builds the piece list: original
+// pieces between the matches, all replacements share one copy.
+// Same length replacements go straight into the file.
+
+void FileDisplay::replace(const Byte* searchFor, Size searchLen, const Byte* with, Size withLen,
+                          const FileDisplay* other)
+{
+        if (! editable) {
+                return;
+        }
+
+        if (withLen == searchLen) {
+                overwrite(searchFor, searchLen, with);
+                return;
+        }
+
+        edits.init(fd, filesize);
+        edits.add.assign((const char*) with, withLen);
+
+        PieceDeq out;
+
+        FPos pos  = 0,
+             last = 0;  // end of the previous match
+        Size count = 0;
+
+        busy(true);
+
+        for (Size got;; pos += got - searchLen + 1) {
+                SeekFile(fd, pos);
+
+                if ((got = ReadFile(fd, buffer, staticSize)) < searchLen || stopRead) {
+                        break;
+                }
+
+                if (ignoreCase) {
+                        lowCase(buffer, got);
+                }
+
+                for (FPos i, from = max(last - pos, (FPos) 0); got - from >= searchLen &&
+                     (i = kernel.scan(buffer + from, got - from, searchFor, searchLen, false)) >= 0; from = last - pos) {
+                        FPos match = pos + from + i;
+
+                        edits.join(out, { last, match - last, srcFile, 0, 0, 0 });
+
+                        if (withLen) {
+                                out.push_back({ 0, withLen, srcAdd, cEdit, 0, 0 });
+                        }
+
+                        last = match + searchLen;
+                        ++count;
+                }
+
+                if (got < staticSize) {
+                        break;
+                }
+        }
+
+        busy();
+
+        if (filesize > last) {
+                edits.join(out, { last, filesize - last, srcFile, 0, 0, 0 });
+        }
+
+        char title[32];
+
+        sprintf(title, " %ld Replaced ", stopRead ? 0 : count);
+
+        positionInWin(side(), strlen(title) + 2, title);
+
+        refreshW(winInput);
+        nap(900);
+
+        if (! count || stopRead) {
+                return;
+        }
+
+        edits.assign(out);
+
+        highEdit(screenWidth);
+
+        edit(other, true);
+} // end FileDisplay::replace
+
+//--------------------------------------------------------------------
+// Same length: the matches of each read are patched in the buffer,
+// then written back in one piece.  No shift, no journal, no undo
+
+void FileDisplay::overwrite(const Byte* searchFor, Size len, const Byte* with)
+{
+        positionInWin(side(), 1+ 23 +3+1, "");
+
+        mvwaddstr(winInput, 1, 1, " Replace in place [y]: ");
+
+        int key = getKey(winInput);
+
+        if (upCase(key) != 'Y') {
+                return;
+        }
+
+        wechochar(winInput, key);
+
+        Measure measure(opWrite);
+
+        File rw = OpenFile(fileName, true);
+
+        FPos pos  = 0,
+             last = 0;  // end of the previous match
+        Size count = 0;
+        bool ret   = rw >= 0;
+
+        busy(true);
+
+        for (Size got; ret; pos += got - len + 1) {
+                SeekFile(rw, pos);
+
+                if ((got = ReadFile(rw, buffer, staticSize)) < len || stopRead) {
+                        break;
+                }
+
+                const Byte *scan = buffer;
+
+                if (ignoreCase) {  // the buffer keeps the original case
+                        memcpy(bufFile2, buffer, got);
+                        lowCase(bufFile2, got);
+
+                        scan = bufFile2;
+                }
+
+                FPos lo = got,
+                     hi = 0;
+
+                for (FPos i, from = max(last - pos, (FPos) 0); got - from >= len &&
+                     (i = kernel.scan(scan + from, got - from, searchFor, len, false)) >= 0; from = last - pos) {
+                        memcpy(buffer + from + i, with, len);
+
+                        lo   = min(lo, from + i);
+                        hi   = from + i + len;
+                        last = pos + hi;
+
+                        ++count;
+                }
+
+                if (hi && WriteAt(rw, buffer + lo, hi - lo, pos + lo) != hi - lo) {
+                        ret = false;
+                }
+
+                if (got < staticSize) {
+                        break;
+                }
+        }
+
+        busy();
+
+        if (rw >= 0) {
+                ret = fsync(rw) == OK && ret;
+                ret = close(rw) == OK && ret;
+        }
+
+        flush();
+        move(0);
+
+        char title[32];
+
+        sprintf(title, ret ? " %ld Replaced " : " Failed! ", count);
+
+        positionInWin(side(), strlen(title) + 2, title);
+
+        if (ret) {
+                refreshW(winInput);
+                nap(900);
+        }
+        else {
+                getKey(winInput);
+        }
+} // end FileDisplay::overwrite
+
+//--------------------------------------------------------------------
+// Fill, copy from the other file or delete the marked range  ##:range
+
+void FileDisplay::range(const FileDisplay* other, FPos lo, Size len)
+{
+        char title[32];
+
+        sprintf(title, " Range %ld Bytes ", len);
+
+        hideCursor();
+        positionInWin(side(), 1+ 28 +1, title, 5);
+
+        mvwaddstr(winInput, 2, 1, other ? "  F Fill  C Copy  D Delete  "
+                                        : "  F Fill  D Delete          ");
+
+        mvwchgat(winInput, 2,  3, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+        mvwchgat(winInput, 2, 11, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+
+        if (other) {
+                mvwchgat(winInput, 2, 19, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+        }
+
+        int key = upCase(getKey(winInput));
+
+        if (key == 'D') {
+                edits.erase(lo, len);
+        }
+
+        else if (key == 'C' && other) {  // same alignment as Enter
+                FPos from = other->offset + lo - offset;
+
+                if (from >= 0 && from < other->filesize) {
+                        edits.copy(lo, min(len, other->filesize - from), from);
+                }
+        }
+
+        else if (key == 'F') {
+                positionInWin(side(), screenWidth, " Fill Hex Bytes ");
+
+                int maxlen = screenWidth - 4 - 1;
+                maxlen -= maxlen % 3;
+
+                char buf[maxlen + 1];
+
+                getString(buf, maxlen, hexSearchHistory, hexDigits, true, true);
+
+                int patLen = packHex(buf);
+
+                if (patLen) {
+                        edits.fill(lo, len, (Byte*) buf, patLen);
+                }
+        }
+} // end FileDisplay::range
+
+//--------------------------------------------------------------------
+// Write the edited file in place  ##:commit
+
+bool FileDisplay::commit(PieceTable& pt)
+{
+        bool ret  = false;
+        int  undo = 0;
+
+        close(fd);
+        fd = OpenFile(fileName, true);
+
+        Journal jr(fileName);
+
+        pt.plan(jr);
+
+        if (assure(jr.remain())) {
+                if (jr.create() || jr.direct()) {
+                        ret = WriteTail(jr) || (undo = recover(jr, jr.stopped ? " Interrupted " : " Write failed ")) > 0;
+                }
+        }
+
+        if (ret) {
+                if (fsync(fd) == OK) {
+                        if (close(fd) == ERR) {  // seamless error tracking
+                                ret = false;
+                        }
+
+                        fd = -1;
+                }
+                else {
+                        ret = false;
+                }
+        }
+
+        if (fd > 0) {
+                close(fd);
+        }
+
+        fd = OpenFile(fileName);
+
+        filesize = SeekFile(fd, 0, SEEK_END);
+        flush();
+
+        if (ret || (undo >= 0 && (jr.step || jr.done))) {  // the file holds the edits, whole or in part
+                pt.init(fd, filesize);
+        }
+        else {  // untouched or undone: the edits stay
+                pt.fd = fd;
+        }
+
+        move(0);
+
+        updateF();
+
+        if (ret) {
+                positionInWin(side(),
+                        1+ (*bufTimer ? strlen(bufTimer) : 11) +1, "", *bufTimer ? 7 : 5);
+
+                mvwaddstr(winInput, 2, *bufTimer ? (strlen(bufTimer) - 11) / 2 + 1 : 1, "  Success  ");
+
+                if (*bufTimer) {
+                        mvwaddstr(winInput, 4, 1, bufTimer);
+                        getKey(winInput);
+
+                        *bufTimer = 0;
+                }
+                else {
+                        refreshW(winInput);
+                        nap(900);
+                }
+        }
+
+        else {
+                positionInWin(side(), 1+ 11 +1, "", 5);
+
+                mvwaddstr(winInput, 2, 1, undo ? "  Undone   " : "  Failed!  ");
+                getKey(winInput);
+        }
+
+        return ret;
+} // end FileDisplay::commit
+
+//--------------------------------------------------------------------
+// Write the edited file to a new file  ##:save
+//
+// Unchanged pieces are cloned or copied by the kernel, only the new
+// bytes are written.  The result replaces the target by rename.
+
+bool FileDisplay::saveAs(PieceTable& pt, const char* path)
+{
+        Measure measure(opWrite);
+
+        struct stat st,
+                    own;
+
+        fstat(fd, &own);
+
+        bool exists = stat(path, &st) == OK,
+             self   = exists && st.st_dev == own.st_dev && st.st_ino == own.st_ino,
+             ret    = ! exists || S_ISREG(st.st_mode);  // no rename over devices
+
+        string tmp = string(path) + ".vbl-tmp";
+
+        File out = ret ? open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, own.st_mode & 0777) : -1;
+
+        if (out >= 0) {
+                int blocks = 25,
+                    count  = 0;
+
+                stopRead = false;
+
+                wchar_t bar[blocks + 1];
+                memset(bar, 0, sizeof(bar));
+
+                hideCursor();
+                positionInWin(side(), 2+ blocks +2, "");
+
+                fstat(out, &st);
+
+                PieceDeq pieces = pt.list();
+
+                FPos at    = 0;
+                Size total = pt.size ? pt.size : 1;
+
+                for (auto &p : pieces) {
+                        for (Size done=0, len; ret && done < p.len; done += len) {
+                                len = min(p.len - done, (Size) staticSize * (p.src == srcFill ? 1 : 16));
+
+                                if (p.src == srcFile || p.src == srcOther) {
+                                        ret = CopyRange(p.src == srcFile ? fd : pt.other, p.pos + done, out, at + done, len, st.st_blksize);
+                                }
+                                else if (p.src == srcAdd) {
+                                        ret = WriteAt(out, pt.add.data() + p.pos + done, len, at + done) == len;
+                                }
+                                else {
+                                        pt.read(at + done, buffer, len);
+
+                                        ret = WriteAt(out, buffer, len, at + done) == len;
+                                }
+
+                                while (count < (at + done + len) * blocks * 8 / total) {
+                                        progress(bar, count++, 0);
+                                }
+
+                                PollEscape();
+
+                                if (stopRead) {
+                                        ret = false;
+                                }
+                        }
+
+                        at += p.len;
+                }
+
+                ret = ret && ftruncate(out, pt.size) == OK && fsync(out) == OK;
+                ret = close(out) == OK && ret;
+
+                if (ret && rename(tmp.c_str(), path) == OK) {
+                        SyncDir(path);
+                }
+                else {
+                        unlink(tmp.c_str());
+                        ret = false;
+                }
+        }
+        else {
+                ret = false;
+        }
+
+        if (ret && self) {  // replaced the original, else the edits stay
+                close(fd);
+                fd = OpenFile(fileName);
+
+                filesize = SeekFile(fd, 0, SEEK_END);
+                flush();
+
+                pt.init(fd, filesize);
+
+                move(0);
+        }
+
+        updateF();
+
+        positionInWin(side(), 1+ 11 +1, "", 5);
+
+        mvwaddstr(winInput, 2, 1, ret ? "  Success  " : "  Failed!  ");
+
+        if (ret) {
+                refreshW(winInput);
+                nap(900);
+        }
+        else {
+                getKey(winInput);
+        }
+
+        return ret;
+} // end FileDisplay::saveAs
+
+//--------------------------------------------------------------------
+// Jump a specific percentage forward / backward
+
+void FileDisplay::skip(bool upwards=false)
+{
+        FPos step = filesize / 100;
+
+        if (upwards) {
+                move(step * -skipBack);
+        }
+        else {
+                move(step * skipForw);
+        }
+}
+
+//--------------------------------------------------------------------
+// Synchronize the plains
+//
+// '1' | upper:  sync file1 with file2
+// '2' | lower:  sync file2 with file1
+
+void FileDisplay::sync(const FileDisplay* other)
+{
+        if (other->dataSize) {
+                moveTo(other->offset);
+        }
+        else {
+                moveToEnd();
+        }
+}
+
+//--------------------------------------------------------------------
+// Pick up a write through the other pane of the same file
+
+void FileDisplay::reread(const FileDisplay& other)
+{
+        if (cache == other.cache) {
+                filesize = other.filesize;
+                move(0);
+        }
+}
+
+//--------------------------------------------------------------------
+// Follow a growing file: only the blocks past the old end are read again.
+// With the end in view, the view moves along by whole rows
+
+bool FileDisplay::grow()
+{
+        if (! fd) {
+                return false;
+        }
+
+        Size size = SeekFile(fd, 0, SEEK_END);
+
+        if (size == filesize) {
+                return false;
+        }
+
+        cache->drop(min(size, filesize) / cacheBlock);
+
+        FPos over = size - offset - bufSize;
+        bool pin  = offset + bufSize >= filesize && over > 0;
+
+        filesize = size;
+
+        move(pin ? (over + lineWidth - 1) / lineWidth * lineWidth : 0);
+
+        return true;
+}
+
+//--------------------------------------------------------------------
+// Change the file position  ##:to
+
+void FileDisplay::moveTo(FPos newOffset)
+{
+        if (newOffset < 0) {
+                offset = 0;
+        }
+        else if (newOffset > filesize) {
+                offset = filesize;
+        }
+        else {
+                offset = newOffset;
+        }
+
+        int way = offset < readOff ? -1 : 1;
+
+        readOff = offset;
+
+        for (dataSize = 0; dataSize < bufSize;) {
+                FPos pos = offset + dataSize;
+                int slot = cache->block(fd, pos / cacheBlock, way),
+                    from = pos % cacheBlock,
+                    len  = min<Size>(cache->length(slot) - from, bufSize - dataSize);
+
+                if (len <= 0) {
+                        break;
+                }
+
+                memcpy(dataF + dataSize, cache->bytes(slot) + from, len);
+                dataSize += len;
+        }
+}
+
+//--------------------------------------------------------------------
+// Change the file position by searching
+
+void FileDisplay::moveForw(const Byte* searchFor, Size searchLen)
+{
+        FPos newPos = searchOff > 0 ? searchOff + 1 : (searchOff < 0 ? 1 : offset);
+
+        for (;;) {
+                SeekFile(fd, newPos);
+                Size bytesRead = ReadFile(fd, buffer, staticSize);
+
+                if (bytesRead < searchLen || stopRead) {
+                        break;
+                }
+
+                if (ignoreCase) {
+                        lowCase(buffer, bytesRead);
+                }
+
+                FPos i = kernel.scan(buffer, bytesRead, searchFor, searchLen, false);
+
+                if (i >= 0) {
+                        newPos    = newPos + i;
+                        searchOff = newPos ? newPos : -1;  // tri-state
+                        se4rch    = searchLen;
+
+                        moveTo(newPos - (searchOff >= searchIndent ? searchIndent : 0));
+                        return;
+                }
+
+                newPos += staticSize - searchLen + 1;
+        }
+
+        moveTo(stopRead ? newPos : filesize);
+
+        searchOff = 0;
+} // end FileDisplay::moveForw
+
+//--------------------------------------------------------------------
+// Change the file position by searching backwards
+
+void FileDisplay::moveBack(const Byte* searchFor, Size searchLen)
+{
+        FPos newPos = searchOff > 0 ? searchOff : offset;
+
+        if (newPos + searchLen - 1 > filesize) {
+                newPos = filesize - searchLen + 1;
+        }
+
+        for (;;) {
+                newPos -= staticSize - searchLen + 1;
+
+                SeekFile(fd, newPos > 0 ? newPos : 0);
+                Size bytesRead = ReadFile(fd, buffer, staticSize);
+
+                if (ignoreCase) {
+                        lowCase(buffer, bytesRead);
+                }
+
+                FPos i = kernel.scan(buffer, staticSize + (newPos < 0 ? newPos : 0), searchFor, searchLen, true);
+
+                if (i >= 0) {
+                        newPos    = (newPos > 0 ? newPos : 0) + i;
+                        searchOff = newPos ? newPos : -1;
+                        se4rch    = searchLen;
+
+                        moveTo(newPos - (searchOff >= searchIndent ? searchIndent : 0));
+                        return;
+                }
+
+                if (newPos <= 0 || stopRead) {
+                        break;
+                }
+        }
+
+        moveTo(stopRead ? newPos : 0);
+
+        searchOff = 0;
+} // end FileDisplay::moveBack
+
+//--------------------------------------------------------------------
+// Change the file position by a scan kernel
+//
+// scan gets each block and returns the first (back: last) match
+// start of size bytes or -1
+
+void FileDisplay::moveScan(Size size, bool back, const function<FPos(Byte*, Size)>& scan)
+{
+        FPos newPos = back ? (searchOff > 0 ? searchOff : offset) + size - 1 :
+                             (searchOff > 0 ? searchOff + 1 : (searchOff < 0 ? 1 : offset));
+
+        for (newPos = min(newPos, filesize); ! stopRead;) {
+                FPos from = back ? max<FPos>(newPos - staticSize, 0) : newPos;
+
+                SeekFile(fd, from);
+                Size bytesRead = ReadFile(fd, buffer, back ? newPos - from : staticSize);
+
+                if (bytesRead < size || stopRead) {
+                        break;
+                }
+
+                FPos i = scan(buffer, bytesRead);
+
+                if (i >= 0) {
+                        newPos    = from + i;
+                        searchOff = newPos ? newPos : -1;
+                        se4rch    = size;
+
+                        moveTo(newPos - (searchOff >= searchIndent ? searchIndent : 0));
+                        return;
+                }
+
+                if (back ? ! from : bytesRead < staticSize) {
+                        break;
+                }
+
+                newPos = back ? from + size - 1 : newPos + staticSize - size + 1;
+        }
+
+        moveTo(stopRead ? newPos : (back ? 0 : filesize));
+
+        searchOff = 0;
+} // end FileDisplay::moveScan
+
+//--------------------------------------------------------------------
+// Change the file position by a typed value search
+
+void FileDisplay::moveValue(const ValueQuery& q, bool back)
+{
+        moveScan(q.size, back, [&](Byte* buf, Size len) {
+                return ScanValue(buf, len, q, back);
+        });
+}
+
+//--------------------------------------------------------------------
+// Change the file position by an approximate search
+
+void FileDisplay::moveFuzzy(const Byte* searchFor, Size searchLen, int k, bool back)
+{
+        moveScan(searchLen, back, [&](Byte* buf, Size len) {
+                if (ignoreCase) {
+                        lowCase(buf, len);
+                }
+
+                FPos i = ScanFuzzy(buf, len, searchFor, searchLen, k, back);
+
+                for (Size j = 0; i >= 0 && j < searchLen; ++j) {  // where it differs
+                        if (buf[i + j] != searchFor[j]) {
+                                se4rchMiss |= 1ul << (searchLen - 1 - j);
+                        }
+                }
+
+                return i;
+        });
+}
+
+//--------------------------------------------------------------------
+// Change the file position by a bit-shifted / XOR search
+
+void FileDisplay::moveBits(const Byte* searchFor, Size searchLen, int mode, bool back)
+{
+        int how = 0;
+
+        moveScan(searchLen + (mode & bitsShift ? 1 : 0), back, [&](Byte* buf, Size len) {
+                return ScanBits(buf, len, searchFor, searchLen, mode, back, how);
+        });
+
+        if (searchOff) {
+                se4rch    = searchLen + (how >> 8 ? 1 : 0);
+                se4rchHow = how + 1;
+        }
+}
+
+//--------------------------------------------------------------------
+// Seek to next byte not equal to current head
+
+void FileDisplay::seekNotChar(bool upwards=false)
+{
+        const int blockSize = 1024 * 1024;
         Byte *const searchBuf = new Byte[blockSize];
 
-        Byte searchFor = *dataF;
-        if (modeAscii && ! isprint(searchFor)) { searchFor = ' '; }
+        Byte searchFor = *dataF;
+        if (modeAscii && ! isprint(searchFor)) { searchFor = ' '; }
+
+        FPos newPos = upwards ? offset - blockSize : offset + 1;
+        int bytesRead;
+        int diff = 0, here = -1;
+
+        for (;;) {
+                if (newPos < 0) { diff = newPos; newPos = 0; }
+                SeekFile(fd, newPos);
+                if (((bytesRead = ReadFile(fd, searchBuf, blockSize)) <= 0) || stopRead) break;
+
+                if (modeAscii) {
+                        for (int i=0; i < bytesRead; ++i) {
+                                if (! ((unsigned) searchBuf[i] - ' ' < '_')) {
+                                        searchBuf[i] = ' ';
+                                }
+                        }
+                }
+
+                here = kernel.notByte(searchBuf, upwards ? blockSize + diff : bytesRead, searchFor, upwards);
+                if (here >= 0) goto done;
+
+                if (upwards) {
+                        if (! newPos) break;
+                        newPos -= blockSize;
+                }
+                else {
+                        newPos += blockSize;
+                }
+        }
+done:
+        delete [] searchBuf;
+        if      (here >= 0) { moveTo(newPos + here); se4rch = 1; }
+        else if (stopRead)  { moveTo(newPos); }
+        else if (upwards)   { moveTo(0); }
+        else                { moveToEnd(); }
+} // end FileDisplay::seekNotChar
+
+//--------------------------------------------------------------------
+// Scroll forward with skipping same content lines
+
+void FileDisplay::smartScroll()
+{
+        FPos newPos = scrollOff ? scrollOff : (offset & ~0xF) + steps[cmmMovePage];
+
+        if (filesize - newPos < bufSize) {
+                scrollOff = 0;
+                moveTo(newPos);
+
+                if (! dataSize) {
+                        moveToEnd();
+                }
+                return;
+        }
+        offset = newPos;
+
+        const int blockSize = 1000 * bufSize;
+        Byte* scrollBuf = new Byte[blockSize];
+
+        Byte buf[lineWidth];
+        FPos repeat = 0;
+
+        SeekFile(fd, newPos);
+        int bytesRead = ReadFile(fd, scrollBuf, blockSize);
+
+        memcpy(dataF, scrollBuf, lineWidth);
+        bytesRead -= lineWidth;
+
+        if (modeAscii) {
+                for (int i=0; i < lineWidth; ++i) {
+                        if (! isprint(dataF[i])) {
+                                dataF[i] = ' ';
+                        }
+                }
+        }
+
+        int i = 1, j = 1;
+        for (; bytesRead > 0;) {
+                if (bytesRead >= lineWidth) {
+                        memcpy(buf, scrollBuf + j * lineWidth, lineWidth);
+
+                        if (modeAscii) {
+                                for (int k=0; k < lineWidth; ++k) {
+                                        if (! isprint(buf[k])) {
+                                                buf[k] = ' ';
+                                        }
+                                }
+                        }
+
+                        if (memcmp(dataF + (i - 1) * lineWidth, buf, lineWidth)) {
+                                memcpy(dataF + i * lineWidth, buf, lineWidth);
+
+                                *(addr + i) = repeat;
+                                repeat = 0;
+                                ++i;
+
+                        }
+                        else {
+                                ++repeat;
+                        }
+
+                        if (i == numLines) {
+                                --i;
+                                break;
+                        }
+
+                        bytesRead -= lineWidth;
+                        ++j;
+                }
+
+                if (bytesRead < lineWidth) {
+                        newPos += j * lineWidth;
+                        j = 0;
+
+                        SeekFile(fd, newPos);
+                        bytesRead = ReadFile(fd, scrollBuf, blockSize);
+
+                        if (bytesRead > 0) {
+                                if (bytesRead < lineWidth || stopRead) {
+                                        *(addr + i) = repeat;
+
+                                        memcpy(dataF + i * lineWidth, scrollBuf, min(bytesRead, lineWidth));
+                                        break;
+                                }
+
+                        }
+
+                        else {
+                                if (repeat) {
+                                        *(addr + i) = --repeat;
+
+                                        memcpy(dataF + i * lineWidth, dataF + (i - 1) * lineWidth, lineWidth);
+                                        ++i;
+                                }
+                        }
+                }
+        }
+
+        /* Gosh! All 4 exit points land here. */
+        scrollOff = newPos + j * lineWidth;
+
+        dataSize = i * lineWidth + min(bytesRead, lineWidth);
+
+        delete [] scrollBuf;
+} // end FileDisplay::smartScroll
+
+//--------------------------------------------------------------------
+// Entropy map of the file  ##:mapui
+//
+// One cell per character, filled in while the threads run.
+// Returns the offset to jump to, -1 if none
+
+FPos FileDisplay::showMap()
+{
+        short wAddr = sizeTera ? 12 : 9,
+              rows  = linesTotal - 2,
+              cols  = (screenWidth - wAddr - 4) & ~15,
+              left  = wAddr + 3;
+
+        FPos cell = max<FPos>((filesize + rows * cols - 1) / (rows * cols), mapCell);
+
+        cell = (cell + mapCell - 1) / mapCell * mapCell;
+
+        int used = (filesize + cell - 1) / cell,
+            cur  = min<FPos>(offset / cell, used - 1),
+            key  = 0;
+
+        if (! used) {
+                return -1;
+        }
+
+        entropyMap.start(fileName, filesize, cell);
+
+        WINDOW *win = newwin(linesTotal, screenWidth, 0, 0);
+
+        wbkgd(win, attribStyle[cHelpWin]);
+        keypad(win, TRUE);
+        wtimeout(win, 100);  // redraw while filling
+
+        for (FPos to = -1; ; key = getKey(win)) {
+                int v = -1;
+
+                switch (upCase(key)) {
+                        case KEY_RIGHT:  ++cur;        break;
+                        case KEY_LEFT:   --cur;        break;
+                        case KEY_DOWN:   cur += cols;  break;
+                        case KEY_UP:     cur -= cols;  break;
+                        case KEY_NPAGE:  cur += cols * (rows / 2); break;
+                        case KEY_PPAGE:  cur -= cols * (rows / 2); break;
+                        case KEY_HOME:   cur = 0;      break;
+                        case KEY_END:    cur = used;   break;
+
+                        case 'Z':
+                        case 'T':
+                        case 'C':
+                                for (int i = 1; i < used; ++i) {  // next of that kind, round
+                                        int n = (cur + i) % used,
+                                            a = entropyMap.at(n);
+
+                                        if (a >= 0 && (upCase(key) == 'Z' ? a & mapZero :
+                                                       upCase(key) == 'T' ? a & mapText :
+                                                       ! (a & (mapZero | mapText)) && (a & mapBits) >= 7500)) {
+                                                cur = n;
+                                                break;
+                                        }
+                                }
+                                break;
+
+                        case KEY_RETURN:
+                                to = cur * cell / lineWidth * lineWidth;
+                                // fall through
+
+                        case 'M':
+                                delwin(win);
+                                return to;
+
+                        case KEY_ESCAPE:
+                                entropyMap.cancel();
+                                delwin(win);
+                                return to;
+                }
+
+                cur = max(0, min(cur, used - 1));
+
+                werase(win);
+                box(win, 0, 0);
+
+                for (int i = 0; i < used && i / cols < rows; ++i) {
+                        int a = entropyMap.at(i),
+                            y = 1 + i / cols,
+                            x = i % cols;
+
+                        if (! x) {
+                                char buf[24];
+                                sprintf(buf, "%0*lX", wAddr, i * cell);
+                                mvwaddstr(win, y, 2, buf);
+                                mvwchgat(win, y, 2, wAddr, attribStyle[cAddress], colorStyle[cAddress], NULL);
+                        }
+
+                        chtype c = a < 0            ? '.' | attribStyle[cMainWin] :
+                                   a & mapZero      ? ' ' | attribStyle[cMainWin] :
+                                   a & mapText      ? 't' | attribStyle[cEdit]    :
+                                   (a & mapBits) >= 6500 ? ('0' + ((a & mapBits) + 500) / 1000) | attribStyle[cDiff] :
+                                                      ('0' + ((a & mapBits) + 500) / 1000) | attribStyle[cMainWin];
+
+                        mvwaddch(win, y, left + x, i == cur ? c | A_REVERSE : c);
+
+                        if (i == cur) {
+                                v = a;
+                        }
+                }
+
+                char title[96],
+                     kind[32],
+                     buf[48];
+                FPos pos = cur * cell;
+
+                if (v < 0 || v & mapZero) {
+                        strcpy(kind, v < 0 ? "..." : "zero");
+                }
+                else {
+                        sprintf(kind, "%.2f bits%s", (v & mapBits) / 1000.0, v & mapText ? " text" : "");
+                }
+
+                sprintf(title, " Map  %s  %s  %d%% ", pretty(buf, &pos, 0), kind, entropyMap.percent());
+
+                mvwaddstr(win, 0, (screenWidth - strlen(title)) / 2, title);
+                mvwaddstr(win, linesTotal - 1, 2,
+                        " Enter jump   Zero Text Compressed: next   Map close   Esc stop ");
+                refreshW(win);
+        }
+} // end FileDisplay::showMap
+
+//--------------------------------------------------------------------
+// Strings of the file, filtered  ##:strui
+//
+// The list grows in file order while the threads scan.
+// Returns the offset to jump to, -1 if none
+
+bool contains(const char* text, Size len, const string& part)
+{
+        for (Size i = 0; i + (Size) part.size() <= len; ++i) {
+                Size k = 0;
+
+                while (k < (Size) part.size() && (ignoreCase ? tolower(text[i + k]) == tolower(part[k])
+                                                             : text[i + k] == part[k])) {
+                        ++k;
+                }
+
+                if (k == (Size) part.size()) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+FPos FileDisplay::showStrings()
+{
+        short wAddr = sizeTera ? 12 : 9,
+              rows  = linesTotal - 2,
+              width = screenWidth - wAddr - 10;
+
+        vector<pair<int, int>> list;  // chunk, run
+        string filter;
+
+        int  listed = 0,  // chunks in the list
+             cur    = 0,
+             top    = 0,
+             key    = 0;
+        bool seek   = true;  // to the first string in view
+
+        if (! filesize) {
+                return -1;
+        }
+
+        stringIndex.start(fileName, filesize);
+
+        WINDOW *win = newwin(linesTotal, screenWidth, 0, 0);
+
+        wbkgd(win, attribStyle[cHelpWin]);
+        keypad(win, TRUE);
+        wtimeout(win, 100);  // redraw while scanning
+
+        for (FPos to = -1; ; key = getKey(win)) {
+                int last = list.size() - 1;
+
+                if (key != ERR) {
+                        seek = key == 0;
+                }
+
+                switch (upCase(key)) {
+                        case KEY_DOWN:   ++cur;         break;
+                        case KEY_UP:     --cur;         break;
+                        case KEY_NPAGE:  cur += rows;   break;
+                        case KEY_PPAGE:  cur -= rows;   break;
+                        case KEY_HOME:   cur = 0;       break;
+                        case KEY_END:    cur = last;    break;
+
+                        case '/':
+                        case 'F': {
+                                char buf[screenWidth];
+
+                                positionInWin(side(), screenWidth, " Filter ");
+                                getString(buf, screenWidth - 5, filterHistory);
+                                hideCursor();
+
+                                filter = buf;
+                                list.clear();
+                                listed = cur = top = 0;
+                                last   = -1;
+                                break;
+                        }
+
+                        case KEY_RETURN:
+                                if (last >= 0) {
+                                        const StringIndex::Run& r = stringIndex.at(list[cur].first).runs[list[cur].second];
+
+                                        to = r.off - r.off % lineWidth;
+                                }
+                                // fall through
+
+                        case 'X':
+                                delwin(win);
+                                return to;
+
+                        case KEY_ESCAPE:
+                                stringIndex.cancel();
+                                delwin(win);
+                                return to;
+                }
+
+                for (; listed < stringIndex.count() && stringIndex.at(listed).done; ++listed) {
+                        const StringIndex::Chunk& c = stringIndex.at(listed);
+
+                        for (int r = 0; r < (int) c.runs.size(); ++r) {
+                                if (filter.empty() || contains(c.text.data() + c.runs[r].at, c.runs[r].len, filter)) {
+                                        if (seek && c.runs[r].off >= offset) {
+                                                cur  = list.size();
+                                                seek = false;
+                                        }
+
+                                        list.push_back(make_pair(listed, r));
+                                }
+                        }
+                }
+
+                cur = max(0, min<int>(cur, list.size() - 1));
+                top = max(min(top, cur), cur - rows + 1);
+
+                werase(win);
+                box(win, 0, 0);
+
+                for (int y = 0; y < rows && top + y < (int) list.size(); ++y) {
+                        const StringIndex::Chunk& c = stringIndex.at(list[top + y].first);
+                        const StringIndex::Run&   r = c.runs[list[top + y].second];
+
+                        char buf[24];
+                        sprintf(buf, "%0*lX  %c", wAddr, r.off, r.wide ? 'U' : 'A');
+
+                        mvwaddstr(win, 1 + y, 2, buf);
+                        mvwaddnstr(win, 1 + y, wAddr + 7, c.text.data() + r.at, min<int>(r.len, width));
+                        mvwchgat(win, 1 + y, 2, wAddr, attribStyle[cAddress], colorStyle[cAddress], NULL);
+
+                        if (top + y == cur) {
+                                mvwchgat(win, 1 + y, 1, screenWidth - 2, attribStyle[cHighFile], colorStyle[cHighFile], NULL);
+                        }
+                }
+
+                char title[64],
+                     buf[48];
+                FPos found = list.size();
+
+                sprintf(title, " Strings  %s%s  %d%% ", pretty(buf, &found, 0),
+                        stringIndex.full() ? "  index full" : "",
+                        stringIndex.count() ? listed * 100 / stringIndex.count() : 100);
+
+                mvwaddstr(win, 0, (screenWidth - strlen(title)) / 2, title);
+                mvwaddstr(win, linesTotal - 1, 2,
+                        " Enter jump   / Filter   eXtract close   Esc stop ");
+                refreshW(win);
+        }
+} // end FileDisplay::showStrings
+
+//--------------------------------------------------------------------
+// Scan for file signatures, then pick one  ##:carve
+//
+// Like the search: big reads, the next one announced ahead.
+// Esc ends the scan, the list shows what was found
+
+FPos FileDisplay::carve()
+{
+        vector<pair<FPos, int>> hits;
+
+        int blocks = 25,
+            bars   = 0,
+            key    = 0;
+
+        initSignatures();
+
+        wchar_t bar[blocks + 1];
+        memset(bar, 0, sizeof(bar));
+
+        hideCursor();
+        positionInWin(side(), 2+ blocks +2, "");
+
+        for (FPos pos = 0; pos < filesize && ! stopRead; pos += staticSize - sigSpan + 1) {
+                SeekFile(fd, pos);
+                posix_fadvise(fd, pos + staticSize, staticSize, POSIX_FADV_WILLNEED);
+
+                Size got = ReadFile(fd, buffer, staticSize);
+
+                if (got <= 0) {
+                        break;
+                }
+
+                bool last = pos + got >= filesize;
+
+                scanSignatures(buffer, 0, last ? got : got - sigSpan + 1, got, pos, hits);
+
+                while (bars < (pos + got) * blocks * 8 / filesize) {
+                        progress(bar, bars++, 0);
+                }
+        }
+
+        stopRead = false;
+        sort(hits.begin(), hits.end());
+
+        short wAddr = sizeTera ? 12 : 9,
+              rows  = linesTotal - 2;
+        int   cur   = 0,
+              top   = 0;
+
+        for (int i = 0; i < (int) hits.size() && hits[i].first < offset; ++i) {
+                cur = i + 1;
+        }
+
+        WINDOW *win = newwin(linesTotal, screenWidth, 0, 0);
+
+        wbkgd(win, attribStyle[cHelpWin]);
+        keypad(win, TRUE);
+
+        for (FPos to = -1; ; key = getKey(win)) {
+                switch (key) {
+                        case KEY_DOWN:   ++cur;         break;
+                        case KEY_UP:     --cur;         break;
+                        case KEY_NPAGE:  cur += rows;   break;
+                        case KEY_PPAGE:  cur -= rows;   break;
+                        case KEY_HOME:   cur = 0;       break;
+                        case KEY_END:    cur = hits.size();  break;
+
+                        case KEY_RETURN:
+                                if (hits.size()) {
+                                        to = hits[cur].first;
+                                }
+                                // fall through
+
+                        case KEY_ESCAPE:
+                                delwin(win);
+                                return to;
+                }
+
+                cur = max(0, min<int>(cur, hits.size() - 1));
+                top = max(min(top, cur), cur - rows + 1);
+
+                werase(win);
+                box(win, 0, 0);
+
+                for (int y = 0; y < rows && top + y < (int) hits.size(); ++y) {
+                        char buf[96];
+                        sprintf(buf, "%0*lX  %s", wAddr, hits[top + y].first, signatures[hits[top + y].second].name.c_str());
+
+                        mvwaddstr(win, 1 + y, 2, buf);
+                        mvwchgat(win, 1 + y, 2, wAddr, attribStyle[cAddress], colorStyle[cAddress], NULL);
+
+                        if (top + y == cur) {
+                                mvwchgat(win, 1 + y, 1, screenWidth - 2, attribStyle[cHighFile], colorStyle[cHighFile], NULL);
+                        }
+                }
+
+                char title[48],
+                     buf[32];
+                FPos found = hits.size();
+
+                sprintf(title, " Signatures  %s ", pretty(buf, &found, 0));
+
+                mvwaddstr(win, 0, (screenWidth - strlen(title)) / 2, title);
+                mvwaddstr(win, linesTotal - 1, 2, " Enter jump   Esc close ");
+                refreshW(win);
+        }
+} // end FileDisplay::carve
+
+//--------------------------------------------------------------------
+// Checksum of last address..here or the whole file  ##:sumui
+//
+// In two-file mode both files are summed at once and compared
+
+void FileDisplay::checksum(const FileDisplay* other)
+{
+        Command where = side();
+
+        hideCursor();
+        positionInWin(where, 1+ 35 +1, " Checksum ", 5);
+
+        mvwaddstr(winInput, 2, 1, "  C CRC32C  X xxHash64  S SHA-256 ");
+        mvwchgat(winInput, 2,  3, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+        mvwchgat(winInput, 2, 12, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+        mvwchgat(winInput, 2, 24, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+
+        int key = upCase(getKey(winInput));
+
+        SumAlgo algo = key == 'C' ? sumCRC32C : key == 'X' ? sumXXH64 : sumSHA256;
+
+        if (key != 'C' && key != 'X' && key != 'S') {
+                return;
+        }
+
+        bool whole = offset == lastOffset;
+
+        if (! whole) {
+                positionInWin(where, 1+ 35 +1, " Checksum ", 5);
+
+                mvwaddstr(winInput, 2, 1, "  R Range last..here  W Whole file ");
+                mvwchgat(winInput, 2,  3, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                mvwchgat(winInput, 2, 23, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+
+                key   = upCase(getKey(winInput));
+                whole = key == 'W';
+
+                if (key != 'R' && key != 'W') {
+                        return;
+                }
+        }
+
+        const FileDisplay *files[2] = { this, other };
+
+        int count = other ? 2 : 1,
+            blocks = 25,
+            bars   = 0;
+
+        SumJob jobs[2];
+        atomic<bool> stop(false);
+        deque<thread> runs;
+        FPos total = 0;
+
+        for (int i = 0; i < count; ++i) {
+                const FileDisplay *f = files[i];
+
+                jobs[i].fd    = f->fd;
+                jobs[i].from  = whole ? 0 : min(f->offset, f->lastOffset);
+                jobs[i].len   = whole ? f->filesize : max(f->offset, f->lastOffset) - jobs[i].from;
+                jobs[i].algo  = algo;
+                jobs[i].done  = 0;
+                jobs[i].stop  = &stop;
+                jobs[i].ready = false;
+
+                total += jobs[i].len;
+
+                runs.push_back(thread(sumRange, &jobs[i]));
+        }
+
+        wchar_t bar[blocks + 1];
+        memset(bar, 0, sizeof(bar));
+
+        positionInWin(where, 2+ blocks +2, "");
+        wtimeout(winInput, 50);
+
+        while (! jobs[0].ready || ! jobs[count - 1].ready) {
+                while (bars < (jobs[0].done + jobs[count - 1].done * (count - 1)) * blocks * 8 / (total ? total : 1)) {
+                        progress(bar, bars++, 0);
+                }
+
+                if (getKey(winInput) == KEY_ESCAPE) {
+                        stop = true;
+                }
+        }
+
+        wtimeout(winInput, -1);
+
+        for (thread& t : runs) {
+                t.join();
+        }
+
+        if (stop) {
+                return;
+        }
+
+        char title[48],
+             line[2][96],
+             buf[48];
+        int  width = 0;
+
+        for (int i = 0; i < count; ++i) {
+                sprintf(line[i], "  %s  %s  %s bytes ", i ? "2" : "1",
+                        jobs[i].result.size() ? jobs[i].result.c_str() : "read error",
+                        pretty(buf, &jobs[i].len, 0));
+
+                width = max<int>(width, strlen(line[i]));
+        }
+
+        sprintf(title, " %s%s ", sumNames[algo],
+                count == 1 ? "" : jobs[0].result == jobs[1].result ? "  equal" : "  differ");
+
+        positionInWin(where, 1+ width +1, title, 2 + count);
+
+        for (int i = 0; i < count; ++i) {
+                mvwaddstr(winInput, 1 + i, 1, line[i]);
+        }
+
+        getKey(winInput);
+} // end FileDisplay::checksum
+
+//====================================================================
+// Class InputManager
+
+class InputManager
+{
+    private:
+        char           *buf;
+        const char     *restrictChar;
+        StrDeq         &history;
+        size_t          historyPos;
+        string          historyInp;
+        int             maxLen;
+        int             step;
+        int             len = 0;
+        int             cur = 0;
+        bool            upcase;
+        bool            splitHex;
+        bool            overStrike = false;
+
+    private:
+        void    useHistory(int delta);
+
+    public:
+                InputManager(char* Buf, int MaxLen, StrDeq& History):
+                        buf(Buf), history(History), historyPos(History.size()), maxLen(MaxLen) {}
+               ~InputManager()                          {}
+
+        void    setCharacters(const char* RestrictChar) { restrictChar = RestrictChar; }
+        void    setSplitHex(bool SplitHex)              { splitHex = SplitHex; }
+        void    setUpcase(bool Upcase)                  { upcase = Upcase; }
+        void    setStep(int Step)                       { step = Step; }
+
+        void    run();
+}; // end InputManager
+
+//====================================================================
+// Class InputManager member functions
+
+//--------------------------------------------------------------------
+// Switch the current input line with one from the history
+
+void InputManager::useHistory(int delta)
+{
+        if (historyPos == history.size()) {
+                historyInp.assign(buf, len);
+        }
+
+        historyPos += delta;
+
+        string s = historyPos == history.size() ? historyInp : history[historyPos];
+
+        cur = len = s.size();
+
+        memset(buf, ' ', maxLen);
+
+        memcpy(buf, s.data(), len);
+}
+
+//--------------------------------------------------------------------
+// Run the main loop to get an input string  ##:run
+
+void InputManager::run()
+{
+        memset(buf, ' ', maxLen);
+        buf[maxLen] = 0;
+
+        showCursor();
+
+        for (;;) {
+                mvwaddstr(winInput, 1, 2, buf);
+                wmove(winInput, 1, 2 + cur);
+
+                int key = getKey(winInput);
+
+                if (upcase) {
+                        key = upCase(key);
+                }
+
+                if (isprint(key)) {
+                        if (restrictChar && ! strchr(restrictChar, key)) {
+                                continue;
+                        }
+
+                        if (overStrike) {
+                                if (cur >= maxLen) {
+                                        continue;
+                                }
+                        }
+
+                        else {
+                                if (! (cur % step)) {
+                                        if (len + step > maxLen) {
+                                                continue;
+                                        }
+
+                                        if (cur != len) {  // true insert
+                                                memmove(buf + cur + step, buf + cur, len - cur);
+
+                                                len += step;
+
+                                                if (splitHex) {
+                                                        buf[cur + 1] = ' ';
+                                                }
+                                        }
+                                }
+                        }
+
+                        mEdit
+
+                        buf[cur++] = key;
+
+                        if (splitHex && cur % 3 == 2) {
+                                ++cur;
+                        }
+
+                        if (cur > len) {
+                                len = cur;
+                        }
+                }
+
+                else {
+                        if (key == KEY_IC) {
+                                overStrike ^= true;
+                                showCursor(overStrike);
+                                continue;
+                        }
+
+                        if (splitHex && cur) {  // normalize
+                                if (buf[cur] == ' ' && buf[cur - 1] != ' ') {
+                                        buf[cur]     = buf[cur - 1];
+                                        buf[cur - 1] = '0';
+
+                                        if (cur == len) {
+                                                len += 2;
+                                        }
+                                }
+
+                                cur -= cur % step;
+                        }
+
+                        switch (key) {
+                                case KEY_ESCAPE:
+                                case KEY_RETURN:
+                                        buf[key == KEY_RETURN ? len : 0] = 0;
+                                        goto done;
+
+                                case KEY_LEFT:
+                                case KEY_RIGHT:
+                                        if (key == KEY_LEFT ? cur : cur < len) {
+                                                cur = cur + (key == KEY_LEFT ? -step : step);
+                                        }
+                                        break;
+
+                                case KEY_HOME:
+                                case KEY_END:
+                                        cur = key == KEY_END ? len : 0;
+                                        break;
+
+                                case KEY_UP:
+                                        if (historyPos) {
+                                                useHistory(-1);
+                                        }
+                                        break;
+
+                                case KEY_DOWN:
+                                        if (historyPos < history.size()) {
+                                                useHistory(+1);
+                                        }
+                                        break;
+
+                                case KEY_DC:
+                                        if (cur >= len) {
+                                                continue;
+                                        }
+
+                                        mEdit
+
+                                        memmove(buf + cur, buf + cur + step, len - cur - step);
+                                        memset(buf + len - step, ' ', step);
+
+                                        len -= step;
+                                        break;
+
+                                case KEY_BACKSPACE:
+                                        if (! cur) {
+                                                continue;
+                                        }
+
+                                        mEdit
+
+                                        memmove(buf + cur - step, buf + cur, len - cur);
+                                        memset(buf + len - step, ' ', step);
+
+                                        cur -= step;
+                                        len -= step;
+                                        break;
+
+                                case KEY_CTRL_U:  // unix-line-discard
+                                        mEdit
+
+                                        memmove(buf, buf + cur, len - cur);
+                                        memset(buf + len - cur, ' ', cur);
+
+                                        len -= cur;
+                                        cur = 0;
+                                        break;
+
+                                case KEY_CTRL_K:  // kill-line
+                                        mEdit
+
+                                        memset(buf + cur, ' ', len - cur);
+                                        len = cur;
+                        }
+                }
+        }
+
+done:
+        hideCursor();
+
+        if (*buf) {
+                for (auto exists = history.begin(); exists != history.end(); ++exists) {
+                        if (*exists == buf) {
+                                history.erase(exists);
+                                break;
+                        }
+                }
+
+                if (history.size() == maxHistory) {
+                        history.pop_front();
+                }
+
+                history.push_back(buf);
+        }
+
+        return;
+} // end InputManager::run
+
+//====================================================================
+// Global Functions which uses Objects
+
+//--------------------------------------------------------------------
+// Parse a goto position, rel: -1 backward, 1 forward, 0 absolute
+
+FPos scanPosition(const char* input, Size size, int& rel)
+{
+        string str = input;
+        char *buf = &str[0];
+
+        rel = 0;
+
+        if (*buf == '+') {
+                ++rel;
+        }
+
+        if (*buf == '-') {
+                --rel;
+        }
+
+        if (rel) {
+                *buf = ' ';
+        }
+
+        FPos pos = 0;
+
+        if (strchr(buf, '%')) {
+                int i = atoi(buf);
+
+                if (i >= 1 && i <= 99) {
+                        pos = size / 100 * i;
+                }
+                else if (i >= 100) {
+                        pos = size - steps[cmmMovePage];
+                }
+        }
+
+        else if (strpbrk(buf, "ABCDEFXabcdefx")) {
+              pos = strtoull(buf, NULL, 16);
+        }
+
+        else {
+              pos = strtoull(buf, NULL, 10);
+        }
+
+        const char* ptr = strpbrk(buf, sPrefix);
+
+        if (ptr) {
+                ptr = strchr(sPrefix, *ptr);
+
+                pos *= aPrefix[ptr - sPrefix];
+        }
+
+        return pos;
+} // end scanPosition
+
+//--------------------------------------------------------------------
+// Get a string using InputManager
+
+void getString(char* buf, int maxlen, StrDeq& history,
+                        const char* restrictChar, bool upcase, bool splitHex)
+{
+        InputManager manager(buf, maxlen, history);
+
+        manager.setCharacters(restrictChar);
+        manager.setSplitHex(splitHex);
+        manager.setUpcase(upcase);
+        manager.setStep(splitHex ? 3 : 1);
+
+        manager.run();
+}
+
+//--------------------------------------------------------------------
+// Program setup  ##:s
+
+void setup()
+{
+        calcScreenLayout();  // global vars
+
+        initLUT();
+        initCRC();
+        initKernels();
+
+        if (! (winInput = newwin(3, inWidth, 0, 0))) {
+                exitMsg(22, "Failed to create input window.");
+        }
+        keypad(winInput, true);
+
+        if (! (winHelp = newwin(helpHeight, helpWidth,
+                              1 + (linesTotal - helpHeight) / 3,
+                              1 + (screenWidth - helpWidth) / 2))) {
+                exitMsg(23, "Failed to create help window.");
+        }
+
+        wbkgd(winHelp, attribStyle[cHelpWin]);
+
+        if (! singleFile) {
+                diffs.resizeD();
+        }
+
+        file1.initF(0, (singleFile ? NULL : &diffs));
+
+        if (! singleFile) {
+                file2.initF(numLines + 1, &diffs);
+        }
+
+        for (size_t i = 0; i < views.size(); ++i) {
+                views[i]->initF(((singleFile ? 1 : 2) + i) * (numLines + 1), NULL, true);
+        }
+} // end setup
+
+//--------------------------------------------------------------------
+// Next narrower row width, after 16 back to auto-fit
+
+void cycleWidth()
+{
+        const int widths[] = { 128, 64, 48, 32, 24, 16, 0 };
+
+        int i = 0;
+        while (widths[i] && widths[i] >= lineWidthAsc / 4) {  // hex width
+                ++i;
+        }
+        widthWanted = widths[i];
+
+        calcScreenLayout();
+
+        mvwin(winHelp, 1 + (linesTotal - helpHeight) / 3, 1 + (screenWidth - helpWidth) / 2);
+
+        erase();  // the old layout may be wider
+        refreshW(stdscr);
+
+        if (! singleFile) {
+                diffs.resizeD();
+                file2.resizeF();
+        }
+        file1.resizeF();
+
+        for (FileDisplay *view : views) {
+                view->resizeF();
+        }
+} // end cycleWidth
+
+//--------------------------------------------------------------------
+// Share the screen again after a view came or went  ##:view
+
+void relayout()
+{
+        calcScreenLayout();
+
+        erase();  // rows left over below the panes
+        refreshW(stdscr);
+
+        if (! singleFile) {
+                diffs.resizeD();
+                file2.place(numLines + 1);
+        }
+        file1.place(0);
+
+        for (size_t i = 0; i < views.size(); ++i) {
+                views[i]->place(((singleFile ? 1 : 2) + i) * (numLines + 1));
+        }
+}
+
+//--------------------------------------------------------------------
+// One more view of the file in use, at its offset, below the others.
+// Views of one file share its cache, the new view gets the focus
+
+void addView()
+{
+        FileDisplay& from = viewFocus ? *views[viewFocus - 1] : lockState == lockTop ? file2 : file1;
+
+        if (linesTotal / (panes + 1) - 1 < minViewLines) {  // no room
+                beep();
+                return;
+        }
+
+        FileDisplay *view = new FileDisplay();  // zeroed like file1, file2
+
+        if (! view->setFile(from.fileName)) {
+                delete view;
+                beep();
+                return;
+        }
+
+        view->startAddr = from.offset;
+
+        ++panes;
+        relayout();
+
+        views.push_back(view);
+        view->initF((panes - 1) * (numLines + 1), NULL, true);
+
+        viewFocus = views.size();
+}
+
+//--------------------------------------------------------------------
+// Close the view with the focus, else the last one
+
+void closeView()
+{
+        int n = viewFocus ? viewFocus : views.size();
+
+        delete views[n - 1];
+        views.erase(views.begin() + n - 1);
+
+        viewFocus = 0;
+
+        --panes;
+        relayout();
+}
+
+//--------------------------------------------------------------------
+// The view with the focus, if the command leaves the pair alone
+
+FileDisplay* focused(Command cmd)
+{
+        return viewFocus && ! (cmd & (cmgGotoTop | cmgGotoBottom)) ? views[viewFocus - 1] : NULL;
+}
+
+//--------------------------------------------------------------------
+// After a write: the views of that file show it
+
+void rereadViews(const FileDisplay& file)
+{
+        for (FileDisplay *view : views) {
+                view->reread(file);
+        }
+}
+
+//--------------------------------------------------------------------
+// Jump the unlocked views, the last address is set
+
+void jumpViews(FPos to)
+{
+        if (to < 0) {
+                return;
+        }
+
+        if (lockState != lockTop) {
+                file1.setLast();
+                file1.moveTo(to);
+        }
+
+        if (lockState != lockBottom && ! singleFile) {
+                file2.setLast();
+                file2.moveTo(to);
+        }
+}
+
+//--------------------------------------------------------------------
+// Follow mode on/off  ##:follow
+
+void toggleFollow()
+{
+        if (followFd >= 0) {
+                close(followFd);
+                followFd = -1;
+                return;
+        }
+
+        if ((followFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+                return;
+        }
+
+        file1.watch();
+        file2.watch();
+
+        file1.grow();  // catch up
+        file2.grow();
+
+        for (FileDisplay *view : views) {
+                view->watch();
+                view->grow();
+        }
+}
+
+//--------------------------------------------------------------------
+// Test progress bar
+
+void ee()
+{
+        for (int blocks = 25, naps = 4, go = 0; ;) {
+                for (int i=1; i;) {
+                        char buf[32];
+                        sprintf(buf, " %d %d ", blocks, naps);
+                        positionInWin(cmgGotoTop, 2+ blocks +2, buf);
+
+                        if (! go++) break;
+
+                        flushinp();
+                        int key = getKey(winInput);
+
+                        switch (key) {
+                                case KEY_UP:     if (naps < 50) ++naps; break;
+                                case KEY_DOWN:   if (naps >  0) --naps; break;
+
+                                case KEY_LEFT:   if (blocks > 3) --blocks; file1.updateF(); break;
+                                case KEY_RIGHT:  if (blocks < screenWidth - 4) ++blocks;    break;
+
+                                case KEY_ESCAPE:  file1.updateF(); return;
+                                default:          --i;
+                        }
+                }
+
+                wchar_t bar[blocks + 1];
+                memset(bar, 0, sizeof(bar));
+
+                for (int i=0; i < blocks; ++i) {
+                        for (int j=0; j < 8; ++j) {
+                                bar[i] = barSyms[j];
+
+                                mvwaddwstr(winInput, 1, 2, bar);
+                                refreshW(winInput);
+                                nap(naps);
+                        }
+                }
+                nap(200);
+        }
+}
+
+//--------------------------------------------------------------------
+// Get a file position and move there  ##:p
+
+void gotoPosition(Command cmd)
+{
+        positionInWin(cmd, inWidth + 1 + 4, " Goto ");  // cursor + border
+
+        char buf[inWidth + 1];
+
+        getString(buf, inWidth, positionHistory, hexDigitsGoto);
+
+        if (! buf[0]) {
+                return;
+        }
+
+        int rel;
+
+        FPos pos1 = scanPosition(buf, file1.filesize, rel),
+             pos2 = scanPosition(buf, file2.filesize, rel);
+
+        if (cmd & cmgGotoTop) {
+                if (rel) {
+                        file1.repeatOff = rel > 0 ? pos1 : -pos1;
+                        file1.move(file1.repeatOff);
+                }
+
+                else {
+                        file1.setLast();
+                        file1.moveTo(pos1);
+                }
+        }
+
+        if (cmd & cmgGotoBottom) {
+                if (rel) {
+                        file2.repeatOff = rel > 0 ? pos2 : -pos2;
+                        file2.move(file2.repeatOff);
+                }
+
+                else {
+                        file2.setLast();
+                        file2.moveTo(pos2);
+                }
+        }
+
+        if (FileDisplay *view = focused(cmd)) {
+                FPos pos = scanPosition(buf, view->filesize, rel);
+
+                if (rel) {
+                        view->repeatOff = rel > 0 ? pos : -pos;
+                        view->move(view->repeatOff);
+                }
+
+                else {
+                        view->setLast();
+                        view->moveTo(pos);
+                }
+        }
+} // end gotoPosition
+
+//--------------------------------------------------------------------
+// Search one view again: value, bits, approximate or bytes
+
+void findNext(FileDisplay& file, bool back)
+{
+        Byte* searchPattern = (Byte*) (ignoreCase ? lastSearchIgnCase.data() : lastSearch.data());
+
+        file.busy(true);
+
+        if (lastValue.size) {
+                file.moveValue(lastValue, back);
+        }
+        else if (lastBits) {
+                file.moveBits((Byte*) lastSearch.data(), lastSearch.size(), lastBits, back);
+        }
+        else if (lastFuzzy) {
+                file.moveFuzzy(searchPattern, lastSearch.size(), lastFuzzy, back);
+        }
+        else if (back) {
+                file.moveBack(searchPattern, lastSearch.size());
+        }
+        else {
+                file.moveForw(searchPattern, lastSearch.size());
+        }
+
+        file.busy();
+}
+
+//--------------------------------------------------------------------
+// Replace all: ask for the pattern and its replacement
+
+void replaceAll(Command cmd, FileDisplay& file, const FileDisplay* other)
+{
+        positionInWin(cmd, 18, " Replace ");
+
+        mvwaddstr(winInput, 1,  2, "H Hex");
+        mvwaddstr(winInput, 1, 10, "T Text");
+
+        mvwchgat(winInput, 1,  2, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+        mvwchgat(winInput, 1, 10, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+
+        int key = upCase(getKey(winInput));
+
+        if (key != 'H' && key != 'T') {
+                return;
+        }
+
+        bool hex = key == 'H';
+
+        int maxlen = screenWidth - 4 - 1;
+
+        if (hex) {
+                maxlen -= maxlen % 3;
+        }
+
+        char find[maxlen + 1],
+             with[maxlen + 1];
+
+        int findLen,
+            withLen;
+
+        positionInWin(cmd, screenWidth, (hex ? " Replace Hex Bytes " : " Replace Text "));
+
+        if (hex) {
+                getString(find, maxlen, hexSearchHistory, hexDigits, true, true);
+
+                findLen = packHex(find);
+        }
+        else {
+                getString(find, maxlen, textSearchHistory);
+
+                findLen = strlen(find);
+        }
+
+        if (! findLen) {
+                return;
+        }
+
+        positionInWin(cmd, screenWidth, " With ");
+
+        if (hex) {
+                getString(with, maxlen, hexSearchHistory, hexDigits, true, true);
+
+                withLen = packHex(with);
+        }
+        else {
+                getString(with, maxlen, textSearchHistory);
+
+                withLen = strlen(with);
+        }
+
+        lastSearch.assign(find, findLen);
+        lastValue.size = 0;
+        lastFuzzy = 0;
+        lastBits = 0;
+
+        lowCase((Byte*) find, findLen);
+
+        lastSearchIgnCase.assign(find, findLen);
+
+        file.replace((Byte*) (ignoreCase ? lastSearchIgnCase.data() : lastSearch.data()), findLen,
+                     (Byte*) with, withLen, other);
+} // end replaceAll
+
+//--------------------------------------------------------------------
+// Search for text or bytes in the files
+
+void searchFiles(Command cmd)
+{
+        const bool havePrev = !lastSearch.empty() || lastValue.size;
+        int key = 0,
+            fuzzy = 0,
+            bits = 0;
+
+        if (! ((cmd & cmfFindNext || cmd & cmfFindPrev) && havePrev)) {
+                positionInWin(cmd, 37, " Find ", 4);
+
+                mvwaddstr(winInput, 1,  2, "H Hex");
+                mvwaddstr(winInput, 1, 10, "T Text");
+                mvwaddstr(winInput, 2,  2, "S Sigs");
+                mvwaddstr(winInput, 2, 10, "V Value");
+                mvwaddstr(winInput, 2, 19, "A Approx");
+                mvwaddstr(winInput, 2, 29, "B Bits");
+
+                mvwchgat(winInput, 1,  2, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                mvwchgat(winInput, 1, 10, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                mvwchgat(winInput, 2,  2, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                mvwchgat(winInput, 2, 10, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                mvwchgat(winInput, 2, 19, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                mvwchgat(winInput, 2, 29, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+
+                if (havePrev) {
+                        mvwaddstr(winInput, 1, 19, "N Next");
+                        mvwaddstr(winInput, 1, 29, "P Prev");
+
+                        mvwchgat(winInput,  1, 19, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                        mvwchgat(winInput,  1, 29, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                }
+
+                key = upCase(getKey(winInput));
+
+                bool hex = false;
+
+                if (key == 'A') {  // up to k bytes may differ, then as usual
+                        positionInWin(cmd, 27, " Approximate ");
+
+                        mvwaddstr(winInput, 1,  2, "1..7 bytes may differ");
+                        mvwchgat(winInput,  1,  2, 4, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+
+                        fuzzy = getKey(winInput) - '0';
+
+                        if (fuzzy < 1 || fuzzy > fuzzyMax) {
+                                return;
+                        }
+                }
+                else if (key == 'B') {  // all bit offsets and / or XOR keys
+                        positionInWin(cmd, 27, " Bits ");
+
+                        mvwaddstr(winInput, 1,  2, "S Shift");
+                        mvwaddstr(winInput, 1, 11, "X Xor");
+                        mvwaddstr(winInput, 1, 18, "A All");
+
+                        mvwchgat(winInput, 1,  2, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                        mvwchgat(winInput, 1, 11, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                        mvwchgat(winInput, 1, 18, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+
+                        switch (upCase(getKey(winInput))) {
+                                case 'S':  bits = bitsShift;            break;
+                                case 'X':  bits = bitsXor;              break;
+                                case 'A':  bits = bitsShift | bitsXor;  break;
+                                default:   return;
+                        }
+                }
+
+                if (fuzzy || bits) {  // then hex or text
+                        positionInWin(cmd, 18, key == 'A' ? " Approximate " : " Bits ");
+
+                        mvwaddstr(winInput, 1,  2, "H Hex");
+                        mvwaddstr(winInput, 1, 10, "T Text");
+
+                        mvwchgat(winInput, 1,  2, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+                        mvwchgat(winInput, 1, 10, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+
+                        key = upCase(getKey(winInput));
+                        key = key == 'H' || key == KEY_ESCAPE ? key : 'T';
+                }
+
+                if (key == KEY_ESCAPE) {
+                        return;
+                }
+                else if (key == 'S') {  // all signatures at once, then a jump list
+                        if (FileDisplay *view = focused(cmd)) {
+                                FPos to = view->carve();
+
+                                if (to >= 0) {
+                                        view->setLast();
+                                        view->moveTo(to);
+                                }
+                        }
+                        else {
+                                jumpViews((cmd & cmgGotoTop ? file1 : file2).carve());
+                        }
+                        return;
+                }
+                else if (key == 'H') {
+                        hex = true;
+                }
+                else if (key == 'V') {
+                        positionInWin(cmd, screenWidth, " Find Value  u8..u64 i8..i64 f32 f64 [le|be]  value or lo..hi ");
+
+                        char buf[screenWidth - 4];
+                        ValueQuery q;
+
+                        getString(buf, screenWidth - 5, valueHistory);
+
+                        if (! parseValue(buf, q)) {
+                                return;
+                        }
+
+                        if (cmd & cmgGotoTop) {
+                                file1.setLast();
+                        }
+
+                        if (cmd & cmgGotoBottom) {
+                                file2.setLast();
+                        }
+
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->setLast();
+                        }
+
+                        lastValue = q;
+                        lastSearch.clear();
+                }
+
+                if (! ((key == 'N' || key == 'P') && havePrev) && key != 'V') {
+                        positionInWin(cmd, screenWidth, (hex ? " Find Hex Bytes " : " Find Text "));
+
+                        int maxlen = screenWidth - 4 - 1;
+
+                        if (hex) {
+                                maxlen -= maxlen % 3;
+                        }
+
+                        char buf[maxlen + 1];
+                        int searchLen;
+
+                        if (hex) {
+                                getString(buf, maxlen, hexSearchHistory, hexDigits, true, true);
+
+                                searchLen = packHex(buf);
+                        }
+                        else {
+                                getString(buf, maxlen, textSearchHistory);
+
+                                searchLen = strlen(buf);
+                        }
+
+                        if (! searchLen || (fuzzy && (searchLen <= fuzzy || searchLen > 64)) || (bits && searchLen < 3)) {
+                                return;
+                        }
+
+                        if (cmd & cmgGotoTop) {
+                                file1.setLast();
+                        }
+
+                        if (cmd & cmgGotoBottom) {
+                                file2.setLast();
+                        }
+
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->setLast();
+                        }
+
+                        lastSearch.assign(buf, searchLen);
+                        lastValue.size = 0;
+                        lastFuzzy = fuzzy;
+                        lastBits = bits;
+
+                        lowCase((Byte*)buf, searchLen);
+
+                        lastSearchIgnCase.assign(buf, searchLen);
+                }
+
+                if (! singleFile) {
+                        file2.updateF();  // kick remnants
+                }
+        }
+
+        Measure measure(opSearch);
+
+        bool back = cmd & cmfFindPrev || key == 'P';
+
+        if (cmd & cmgGotoTop) {
+                findNext(file1, back);
+        }
+
+        if (cmd & cmgGotoBottom) {
+                findNext(file2, back);
+        }
+
+        if (FileDisplay *view = focused(cmd)) {
+                findNext(*view, back);
+        }
+} // end searchFiles
+
+//--------------------------------------------------------------------
+// Handle a command  ##:hand
+
+void handleCmd(Command cmd)
+{
+        if (cmd & cmgGoto) {
+                if (cmd & cmgGotoForw) {
+                        if (cmd & cmgGotoTop) {
+                                file1.skip();
+                        }
+                        if (cmd & cmgGotoBottom) {
+                                file2.skip();
+                        }
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->skip();
+                        }
+                }
+
+                else if (cmd & cmgGotoBack) {
+                        if (cmd & cmgGotoTop) {
+                                file1.skip(true);
+                        }
+                        if (cmd & cmgGotoBottom) {
+                                file2.skip(true);
+                        }
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->skip(true);
+                        }
+                }
+
+                else if (cmd & cmgGotoLSet) {
+                        if (cmd & cmgGotoTop) {
+                                file1.setLast();
+                        }
+                        if (cmd & cmgGotoBottom) {
+                                file2.setLast();
+                        }
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->setLast();
+                        }
+                }
+
+                else if ((cmd & cmgGotoMask) == cmgGotoLGet) {
+                        if (cmd & cmgGotoTop) {
+                                file1.getLast();
+                        }
+                        if (cmd & cmgGotoBottom) {
+                                file2.getLast();
+                        }
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->getLast();
+                        }
+                }
+
+                else if ((cmd & cmgGotoMask) == cmgGotoLOff) {
+                        if (cmd & cmgGotoTop) {
+                                file1.move(file1.repeatOff);
+                        }
+                        if (cmd & cmgGotoBottom) {
+                                file2.move(file2.repeatOff);
+                        }
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->move(view->repeatOff);
+                        }
+                }
+
+                else if ((cmd & cmgGotoMask) == cmgGotoNOff) {
+                        if (cmd & cmgGotoTop) {
+                                file1.move(-file1.repeatOff);
+                        }
+                        if (cmd & cmgGotoBottom) {
+                                file2.move(-file2.repeatOff);
+                        }
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->move(-view->repeatOff);
+                        }
+                }
+
+                else {
+                        gotoPosition(cmd);
+                }
+        }
+
+        else if (cmd & cmfFind) {
+                if (cmd & cmfNotCharDn) {
+                        Measure measure(opSearch);
+
+                        if (cmd & cmgGotoTop) {
+                                file1.busy(true);
+
+                                file1.seekNotChar();
+                                file1.busy();
+                        }
+
+                        if (cmd & cmgGotoBottom) {
+                                file2.busy(true);
+
+                                file2.seekNotChar();
+                                file2.busy();
+                        }
+
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->busy(true);
+
+                                view->seekNotChar();
+                                view->busy();
+                        }
+                }
+
+                else if (cmd & cmfNotCharUp) {
+                        Measure measure(opSearch);
+
+                        if (cmd & cmgGotoTop) {
+                                file1.busy(true);
+
+                                file1.seekNotChar(true);
+                                file1.busy();
+                        }
+
+                        if (cmd & cmgGotoBottom) {
+                                file2.busy(true);
+
+                                file2.seekNotChar(true);
+                                file2.busy();
+                        }
+
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->busy(true);
+
+                                view->seekNotChar(true);
+                                view->busy();
+                        }
+                }
+
+                else {
+                        searchFiles(cmd);
+                }
+        }
+
+        else if (cmd & cmmMove) {
+                Measure measure(opScroll);
+
+                int step = steps[cmd & cmmMoveMask];
+
+                if (! (cmd & cmmMoveForward)) {
+                        step *= -1;
+                }
+
+                if (moveNet) {  // folded key repeat
+                        step    = moveNet;
+                        moveNet = 0;
+                }
+
+                if ((cmd & cmmMoveForward) && ! step) {  // special case first
+                        if (cmd & cmgGotoTop) {
+                                file1.setLast();
+                                file1.moveToEnd();
+                        }
+
+                        if (cmd & cmgGotoBottom) {
+                                file2.setLast();
+                                file2.moveToEnd();
+                        }
+
+                        if (FileDisplay *view = focused(cmd)) {
+                                view->setLast();
+                                view->moveToEnd();
+                        }
+                }
+
+                else {
+                        if (cmd & cmgGotoTop) {
+                                if (step) {
+                                        file1.move(step);
+                                }
+                                else {
+                                        file1.setLast();
+                                        file1.moveTo(0);
+                                }
+                        }
+
+                        if (cmd & cmgGotoBottom) {
+                                if (step) {
+                                        file2.move(step);
+                                }
+                                else {
+                                        file2.setLast();
+                                        file2.moveTo(0);
+                                }
+                        }
+
+                        if (FileDisplay *view = focused(cmd)) {
+                                if (step) {
+                                        view->move(step);
+                                }
+                                else {
+                                        view->setLast();
+                                        view->moveTo(0);
+                                }
+                        }
+                }
+        }
+
+        else if (cmd == cmSyncUp) {
+                file1.sync(&file2);
+        }
+
+        else if (cmd == cmSyncDn) {
+                file2.sync(&file1);
+        }
+
+        else if (cmd == cmNextDiff || cmd == cmPrevDiff) {
+                Measure measure(opDiff);
+
+                int size = cmd == cmNextDiff ? bufSize : -bufSize;
+
+                if (lockState) {
+                        lockState = lockNeither;
+                }
 
-        FPos newPos = upwards ? offset - blockSize : offset + 1;
-        int bytesRead;
-        int diff = 0, here = -1;
+                file1.busy(true);
+                file2.busy(true);
 
-        for (;;) {
-                if (newPos < 0) { diff = newPos; newPos = 0; }
-                SeekFile(fd, newPos);
-                if (((bytesRead = ReadFile(fd, searchBuf, blockSize)) <= 0) || stopRead) break;
+                if (haveDiff) {
+                        file1.move(size);
+                        file2.move(size);
+                }
 
-                if (modeAscii) {
-                        for (int i=0; i < bytesRead; ++i) {
-                                if (! ((unsigned) searchBuf[i] - ' ' < '_')) {
-                                        searchBuf[i] = ' ';
-                                }
+                for (int go=1; ! diffs.compute(cmd) && ! stopRead; go=0) {
+                        if (go) {
+                                diffs.speedup(size);
+
+                                file1.move(0);
+                                file2.move(0);
                         }
-                }
 
-                if (upwards) {
-                        for (int i = blockSize - 1 + diff; i >= 0; --i) {
-                                if (searchBuf[i] != searchFor) {
-                                        here = i; goto done;
-                                }
+                        else {
+                                file1.move(size);
+                                file2.move(size);
                         }
-                        if (! newPos) break;
-                        newPos -= blockSize;
+                }
+
+                file1.busy();
+                file2.busy();
+        }
+
+        else if (cmd == cmUseTop) {
+                if (lockState == lockBottom) {
+                        lockState = lockNeither;
                 }
                 else {
-                        for (int i=0; i < bytesRead; ++i) {
-                                if (searchBuf[i] != searchFor) {
-                                        here = i; goto done;
-                                }
-                        }
-                        newPos += blockSize;
+                        lockState = lockBottom;
                 }
         }
-done:
-        delete [] searchBuf;
-        if      (here >= 0) { moveTo(newPos + here); se4rch = 1; }
-        else if (stopRead)  { moveTo(newPos); }
-        else if (upwards)   { moveTo(0); }
-        else                { moveToEnd(); }
-} // end FileDisplay::seekNotChar
 
-//--------------------------------------------------------------------
-// Scroll forward with skipping same content lines
+        else if (cmd == cmUseBottom) {
+                if (lockState == lockTop) {
+                        lockState = lockNeither;
+                }
+                else {
+                        lockState = lockTop;
+                }
+        }
 
-void FileDisplay::smartScroll()
-{
-        FPos newPos = scrollOff ? scrollOff : (offset & ~0xF) + steps[cmmMovePage];
+        else if (cmd == cmShowAscii) {
+                modeAscii ^= true;
 
-        if (filesize - newPos < bufSize) {
-                scrollOff = 0;
-                moveTo(newPos);
+                setViewMode();
+                file1.resizeF();
+                file1.move(0);
 
-                if (! dataSize) {
-                        moveToEnd();
+                for (FileDisplay *view : views) {
+                        view->resizeF();
+                        view->move(0);
                 }
-                return;
         }
-        offset = newPos;
 
-        const int blockSize = 1000 * bufSize;
-        Byte* scrollBuf = new Byte[blockSize];
+        else if (cmd == cmIgnoreCase) {
+                file1.busy(true, true);
+                file2.busy(true, true);
 
-        Byte buf[lineWidth];
-        FPos repeat = 0;
+                ignoreCase ^= true;
+                file1.busy(false, true);
+                file2.busy(false, true);
+        }
 
-        SeekFile(fd, newPos);
-        int bytesRead = ReadFile(fd, scrollBuf, blockSize);
+        else if (cmd == cmShowRaster) {
+                showRaster ^= true;
+        }
 
-        memcpy(dataF, scrollBuf, lineWidth);
-        bytesRead -= lineWidth;
+        else if (cmd == cmMetrics) {
+                showMetrics ^= true;
+        }
 
-        if (modeAscii) {
-                for (int i=0; i < lineWidth; ++i) {
-                        if (! isprint(dataF[i])) {
-                                dataF[i] = ' ';
-                        }
-                }
+        else if (cmd == cmShowMap) {
+                jumpViews((lockState == lockTop ? file2 : file1).showMap());
         }
 
-        int i = 1, j = 1;
-        for (; bytesRead > 0;) {
-                if (bytesRead >= lineWidth) {
-                        memcpy(buf, scrollBuf + j * lineWidth, lineWidth);
+        else if (cmd == cmStrings) {
+                jumpViews((lockState == lockTop ? file2 : file1).showStrings());
+        }
 
-                        if (modeAscii) {
-                                for (int k=0; k < lineWidth; ++k) {
-                                        if (! isprint(buf[k])) {
-                                                buf[k] = ' ';
-                                        }
-                                }
-                        }
+        else if (cmd == cmChecksum) {  // a locked pane is left alone
+                (lockState == lockTop ? file2 : file1).checksum(singleFile || lockState != lockNeither ? NULL : &file2);
+        }
 
-                        if (memcmp(dataF + (i - 1) * lineWidth, buf, lineWidth)) {
-                                memcpy(dataF + i * lineWidth, buf, lineWidth);
+        else if (cmd == cmFollow) {
+                toggleFollow();
+        }
 
-                                *(addr + i) = repeat;
-                                repeat = 0;
-                                ++i;
+        else if (cmd == cmLineWidth) {
+                cycleWidth();
 
-                        }
-                        else {
-                                ++repeat;
-                        }
+                file1.move(0);
 
-                        if (i == numLines) {
-                                --i;
-                                break;
-                        }
+                if (! singleFile) {
+                        file2.move(0);
+                }
 
-                        bytesRead -= lineWidth;
-                        ++j;
+                for (FileDisplay *view : views) {
+                        view->move(0);
                 }
+        }
 
-                if (bytesRead < lineWidth) {
-                        newPos += j * lineWidth;
-                        j = 0;
+        else if (cmd == cmAddView) {
+                addView();
+        }
 
-                        SeekFile(fd, newPos);
-                        bytesRead = ReadFile(fd, scrollBuf, blockSize);
+        else if (cmd == cmCloseView) {
+                closeView();
+        }
 
-                        if (bytesRead > 0) {
-                                if (bytesRead < lineWidth || stopRead) {
-                                        *(addr + i) = repeat;
+        else if (cmd == cmNextView) {
+                viewFocus = (viewFocus + 1) % (views.size() + 1);  // after the last one the pair
+        }
 
-                                        memcpy(dataF + i * lineWidth, scrollBuf, min(bytesRead, lineWidth));
-                                        break;
-                                }
+        else if (cmd == cmShowHelp) {
+                displayHelp();
+        }
 
-                        }
+        else if (cmd == cmEditTop && ! modeAscii) {
+                file1.display();  // reset smartscroll
+                file1.highEdit(screenWidth);
 
-                        else {
-                                if (repeat) {
-                                        *(addr + i) = --repeat;
+                file1.edit(singleFile ? NULL : &file2);
 
-                                        memcpy(dataF + i * lineWidth, dataF + (i - 1) * lineWidth, lineWidth);
-                                        ++i;
-                                }
+                if (! singleFile) {
+                        file2.reread(file1);
+                }
+                rereadViews(file1);
+        }
+
+        else if (cmd == cmEditBottom) {
+                file2.highEdit(screenWidth);
+
+                file2.edit(&file1);
+                file1.reread(file2);
+                rereadViews(file2);
+        }
+
+        else if (cmd == cmReplace) {
+                if (lockState == lockTop) {
+                        replaceAll(cmgGotoBottom, file2, &file1);
+                        file1.reread(file2);
+                        rereadViews(file2);
+                }
+                else if (! modeAscii) {
+                        replaceAll(cmgGotoTop, file1, singleFile ? NULL : &file2);
+
+                        if (! singleFile) {
+                                file2.reread(file1);
                         }
+                        rereadViews(file1);
                 }
         }
 
-        /* Gosh! All 4 exit points land here. */
-        scrollOff = newPos + j * lineWidth;
+        else if (cmd == cmSmartScroll) {
+                Measure measure(opScroll);
 
-        dataSize = i * lineWidth + min(bytesRead, lineWidth);
+                file1.busy(true);
 
-        delete [] scrollBuf;
-} // end FileDisplay::smartScroll
+                file1.smartScroll();
+                file1.busy();
+        }
 
-//====================================================================
-// Class InputManager
+        file1.display();
+        file2.display();
 
-class InputManager
+        for (FileDisplay *view : views) {
+                view->display();
+        }
+
+        if (stopRead) {
+                stopRead = false;
+                nap(500);
+                flushinp();
+        }
+} // end handleCmd
+
+//--------------------------------------------------------------------
+// Run a command of getCommand or of a replay, record it
+
+void runCommand(Command cmd)
 {
-    private:
-        char           *buf;
-        const char     *restrictChar;
-        StrDeq         &history;
-        size_t          historyPos;
-        string          historyInp;
-        int             maxLen;
-        int             step;
-        int             len = 0;
-        int             cur = 0;
-        bool            upcase;
-        bool            splitHex;
-        bool            overStrike = false;
+        if (! (cmd & cmfFind && ! (cmd & (cmfNotCharDn | cmfNotCharUp | cmgGoto)))) {
+                file1.searchOff = file2.searchOff = 0;
 
-    private:
-        void    useHistory(int delta);
+                for (FileDisplay *view : views) {
+                        view->searchOff = 0;
+                }
+        }
 
-    public:
-                InputManager(char* Buf, int MaxLen, StrDeq& History):
-                        buf(Buf), history(History), historyPos(History.size()), maxLen(MaxLen) {}
-               ~InputManager()                          {}
+        if (! (cmd == cmNextDiff || cmd == cmPrevDiff)) {
+                haveDiff = 0;
+        }
 
-        void    setCharacters(const char* RestrictChar) { restrictChar = RestrictChar; }
-        void    setSplitHex(bool SplitHex)              { splitHex = SplitHex; }
-        void    setUpcase(bool Upcase)                  { upcase = Upcase; }
-        void    setStep(int Step)                       { step = Step; }
+        if (cmd != cmSmartScroll) {
+                file1.scrollOff = 0;
+        }
 
-        void    run();
-}; // end InputManager
+        if (recordFile) {
+                fprintf(recordFile, "c %d %d\n", cmd, moveNet);
+        }
 
-//====================================================================
-// Class InputManager member functions
+        recordKeys = true;
+        handleCmd(cmd);
+        recordKeys = false;
+
+        if (recordFile) {
+                fflush(recordFile);
+        }
+}
 
 //--------------------------------------------------------------------
-// Switch the current input line with one from the history
+// Replay the loaded session: one JSON line per command, then a total.
+// Keys left over mean the session ran differently than recorded
 
-void InputManager::useHistory(int delta)
+void replaySession()
 {
-        if (historyPos == history.size()) {
-                historyInp.assign(buf, len);
-        }
+        Full total   = 0,
+             slowest = 0;
+        int  n       = 0,
+             left    = 0;
 
-        historyPos += delta;
+        for (Replay& r : replay) {
+                int keys = r.keys.size();
 
-        string s = historyPos == history.size() ? historyInp : history[historyPos];
+                moveNet    = r.net;
+                replayKeys = &r.keys;
 
-        cur = len = s.size();
+                Full t = clockNs(CLOCK_MONOTONIC);
+
+                runCommand(r.cmd);
+
+                t = clockNs(CLOCK_MONOTONIC) - t;
+
+                total  += t;
+                slowest = max(slowest, t);
+                left   += r.keys.size();
+
+                printf("{\"n\":%d,\"cmd\":%d,\"move\":%d,\"keys\":%d,\"left\":%ld,\"ms\":%.3f}\n",
+                        ++n, r.cmd, r.net, keys, r.keys.size(), t / 1e6);
+        }
 
-        memset(buf, ' ', maxLen);
+        replayKeys = NULL;
 
-        memcpy(buf, s.data(), len);
-}
+        printf("{\"commands\":%d,\"seconds\":%.6f,\"slowestMs\":%.3f,\"keysLeft\":%d}\n",
+                n, total / 1e9, slowest / 1e6, left);
+} // end replaySession
 
 //--------------------------------------------------------------------
-// Run the main loop to get an input string  ##:run
+// Wait for a key, meanwhile update the growing files.
+// A burst of writes is drained and shown as one change
 
-void InputManager::run()
+int followKey()
 {
-        memset(buf, ' ', maxLen);
-        buf[maxLen] = 0;
+        for (;;) {
+                int key = file1.peekKeyF();
 
-        showCursor();
+                if (key != ERR) {
+                        return key;
+                }
 
-        for (;;) {
-                mvwaddstr(winInput, 1, 2, buf);
-                wmove(winInput, 1, 2 + cur);
+                struct pollfd pfd[2] = { { STDIN_FILENO, POLLIN, 0 }, { followFd, POLLIN, 0 } };
 
-                int key = wgetch(winInput);
+                if (poll(pfd, 2, -1) <= 0 || ! (pfd[1].revents & POLLIN)) {
+                        continue;
+                }
 
-                if (upcase) {
-                        key = upCase(key);
+                char events[4096];
+
+                while (read(followFd, events, sizeof(events)) > 0) {
                 }
 
-                if (isprint(key)) {
-                        if (restrictChar && ! strchr(restrictChar, key)) {
-                                continue;
+                bool moved = file1.grow();
+
+                if (file2.grow() || moved) {
+                        if (haveDiff) {
+                                diffs.compute(cmNothing);  // only the bytes in view
                         }
 
-                        if (overStrike) {
-                                if (cur >= maxLen) {
-                                        continue;
-                                }
+                        file1.display();
+                        file2.display();
+                }
+
+                for (FileDisplay *view : views) {
+                        if (view->grow()) {
+                                view->display();
                         }
+                }
+        }
+}
 
-                        else {
-                                if (! (cur % step)) {
-                                        if (len + step > maxLen) {
-                                                continue;
-                                        }
+//--------------------------------------------------------------------
+// Get a command from keyboard  ##:get
+//
+// Moves pending under key repeat are folded into one net move.
 
-                                        if (cur != len) {  // true insert
-                                                memmove(buf + cur + step, buf + cur, len - cur);
+Command moveCommand(int key)
+{
+        switch (key) {
+                case KEY_RIGHT:      return cmmMove | cmmMoveByte | cmmMoveForward;
+                case KEY_DOWN:       return cmmMove | cmmMoveLine | cmmMoveForward;
+                case ' ':            return cmmMove | cmmMovePage | cmmMoveForward;
+                case KEY_LEFT:       return cmmMove | cmmMoveByte;
+                case KEY_UP:         return cmmMove | cmmMoveLine;
+                case KEY_BACKSPACE:  return cmmMove | cmmMovePage;
+        }
 
-                                                len += step;
+        return cmNothing;
+}
 
-                                                if (splitHex) {
-                                                        buf[cur + 1] = ' ';
-                                                }
-                                        }
-                                }
-                        }
+int moveStep(Command cmd)
+{
+        return cmd & cmmMoveForward ? steps[cmd & cmmMoveMask] : -steps[cmd & cmmMoveMask];
+}
 
-                        mEdit
+Command getCommand()
+{
+        Command cmd = cmNothing;
 
-                        buf[cur++] = key;
+        while (cmd == cmNothing) {
+                int key = followFd < 0 ? file1.readKeyF() : followKey();
 
-                        if (splitHex && cur % 3 == 2) {
-                                ++cur;
+                if ((cmd = moveCommand(key))) {  // fold pending moves into one
+                        moveNet = moveStep(cmd);
+
+                        for (Command next; (key = file1.peekKeyF()) != ERR; moveNet += moveStep(next)) {
+                                if (! (next = moveCommand(key))) {
+                                        ungetch(key);
+                                        break;
+                                }
                         }
 
-                        if (cur > len) {
-                                len = cur;
+                        if (! moveNet) {
+                                cmd = cmNothing;
                         }
+                        continue;
                 }
 
-                else {
-                        if (key == KEY_IC) {
-                                overStrike ^= true;
-                                showCursor(overStrike);
-                                continue;
-                        }
+                switch (upCase(key)) {
+                        case KEY_END:        cmd = cmmMove | cmmMoveAll  | cmmMoveForward; break;
+                        case KEY_HOME:       cmd = cmmMove | cmmMoveAll;                   break;
 
-                        if (splitHex && cur) {  // normalize
-                                if (buf[cur] == ' ' && buf[cur - 1] != ' ') {
-                                        buf[cur]     = buf[cur - 1];
-                                        buf[cur - 1] = '0';
+                        case 'F':        cmd = cmfFind;                break;
+                        case 'N':        cmd = cmfFind | cmfFindNext;  break;
+                        case 'P':        cmd = cmfFind | cmfFindPrev;  break;
+                        case KEY_NPAGE:  cmd = cmfFind | cmfNotCharDn; break;
+                        case KEY_PPAGE:  cmd = cmfFind | cmfNotCharUp; break;
 
-                                        if (cur == len) {
-                                                len += 2;
-                                        }
-                                }
+                        case 'G':  cmd = cmgGoto;               break;
+                        case '+':
+                        case '*':
+                        case '=':  cmd = cmgGoto | cmgGotoForw; break;
+                        case '-':  cmd = cmgGoto | cmgGotoBack; break;
+                        case '\'':
+                        case '<':  cmd = cmgGoto | cmgGotoLGet; break;
+                        case 'L':  cmd = cmgGoto | cmgGotoLSet; break;
+                        case '.':  cmd = cmgGoto | cmgGotoLOff; break;
+                        case ',':  cmd = cmgGoto | cmgGotoNOff; break;
 
-                                cur -= cur % step;
-                        }
+                        case 'E':  cmd = lockState == lockTop ? cmEditBottom : cmEditTop; break;
+                        case 'S':  cmd = cmReplace; break;
 
-                        switch (key) {
-                                case KEY_ESCAPE:
-                                case KEY_RETURN:
-                                        buf[key == KEY_RETURN ? len : 0] = 0;
-                                        goto done;
+                        case KEY_RETURN:  cmd = singleFile ? cmSmartScroll : cmNextDiff; break;
 
-                                case KEY_LEFT:
-                                case KEY_RIGHT:
-                                        if (key == KEY_LEFT ? cur : cur < len) {
-                                                cur = cur + (key == KEY_LEFT ? -step : step);
-                                        }
-                                        break;
+                        case '#':
+                        case '\\': if (! singleFile) cmd = cmPrevDiff; break;
 
-                                case KEY_HOME:
-                                case KEY_END:
-                                        cur = key == KEY_END ? len : 0;
-                                        break;
+                        case 'T':  if (! singleFile) cmd = cmUseTop;    break;
+                        case 'B':  if (! singleFile) cmd = cmUseBottom; break;
 
-                                case KEY_UP:
-                                        if (historyPos) {
-                                                useHistory(-1);
-                                        }
-                                        break;
+                        case '1':  if (! singleFile) cmd = cmSyncUp; break;
+                        case '2':  if (! singleFile) cmd = cmSyncDn; break;
 
-                                case KEY_DOWN:
-                                        if (historyPos < history.size()) {
-                                                useHistory(+1);
-                                        }
-                                        break;
+                        case 'A':  if (singleFile) cmd = cmShowAscii; break;
 
-                                case KEY_DC:
-                                        if (cur >= len) {
-                                                continue;
-                                        }
+                        case 'W':  cmd = cmLineWidth; break;
 
-                                        mEdit
+                        case 'O':  cmd = cmFollow; break;
 
-                                        memmove(buf + cur, buf + cur + step, len - cur - step);
-                                        memset(buf + len - step, ' ', step);
+                        case 'M':  cmd = cmShowMap; break;
 
-                                        len -= step;
-                                        break;
+                        case 'C':  cmd = cmChecksum; break;
 
-                                case KEY_BACKSPACE:
-                                        if (! cur) {
-                                                continue;
-                                        }
+                        case 'X':  cmd = cmStrings; break;
 
-                                        mEdit
+                        case 'D':  cmd = cmMetrics; break;
 
-                                        memmove(buf + cur - step, buf + cur, len - cur);
-                                        memset(buf + len - step, ' ', step);
+                        case 'V':  cmd = cmAddView; break;
+                        case 'K':  if (views.size()) cmd = cmCloseView; break;
+                        case KEY_TAB:  if (views.size()) cmd = cmNextView; break;
 
-                                        cur -= step;
-                                        len -= step;
-                                        break;
+                        case 'I':  cmd = cmIgnoreCase; break;
 
-                                case KEY_CTRL_U:  // unix-line-discard
-                                        mEdit
+                        case 'R':  cmd = cmShowRaster; break;
 
-                                        memmove(buf, buf + cur, len - cur);
-                                        memset(buf + len - cur, ' ', cur);
+                        case 'H':  cmd = cmShowHelp; break;
 
-                                        len -= cur;
-                                        cur = 0;
-                                        break;
+                        case 'Z':  ee(); break;
 
-                                case KEY_CTRL_K:  // kill-line
-                                        mEdit
+                        case KEY_ESCAPE:
+                                if (! singleFile && lockState != lockNeither)
+                                        cmd = lockState == lockTop ? cmUseBottom : cmUseTop;
+                                break;  // better off w/o Esc
 
-                                        memset(buf + cur, ' ', len - cur);
-                                        len = cur;
-                        }
+                        case KEY_CTRL_C:
+                        case 'Q':  cmd = cmQuit; break;
                 }
         }
 
-done:
-        hideCursor();
-
-        if (*buf) {
-                for (auto exists = history.begin(); exists != history.end(); ++exists) {
-                        if (*exists == buf) {
-                                history.erase(exists);
-                                break;
-                        }
-                }
-
-                if (history.size() == maxHistory) {
-                        history.pop_front();
-                }
+        if (cmd & (cmmMove | cmfFind | cmgGoto) && ! viewFocus) {  // else the view alone
+                if (lockState != lockTop)
+                        cmd |= cmgGotoTop;
 
-                history.push_back(buf);
+                if (lockState != lockBottom && ! singleFile)
+                        cmd |= cmgGotoBottom;
         }
 
-        return;
-} // end InputManager::run
+        return cmd;
+} // end getCommand
 
 //====================================================================
-// Global Functions which uses Objects
-
-//--------------------------------------------------------------------
-// Get a string using InputManager
-
-void getString(char* buf, int maxlen, StrDeq& history,
-                        const char* restrictChar=NULL, bool upcase=false, bool splitHex=false)
-{
-        InputManager manager(buf, maxlen, history);
-
-        manager.setCharacters(restrictChar);
-        manager.setSplitHex(splitHex);
-        manager.setUpcase(upcase);
-        manager.setStep(splitHex ? 3 : 1);
-
-        manager.run();
-}
-
-//--------------------------------------------------------------------
-// Program setup  ##:s
+// Metrics report on exit  ##:report
+//
+// VBL_METRICS=file (- == stdout): totals per operation as JSON
 
-void setup()
+void reportMetrics()
 {
-        calcScreenLayout();  // global vars
-
-        if (! (winInput = newwin(3, inWidth, 0, 0))) {
-                exitMsg(22, "Failed to create input window.");
-        }
-        keypad(winInput, true);
+        const char *path = getenv("VBL_METRICS");
 
-        if (! (winHelp = newwin(helpHeight, helpWidth,
-                              1 + (linesTotal - helpHeight) / 3,
-                              1 + (screenWidth - helpWidth) / 2))) {
-                exitMsg(23, "Failed to create help window.");
+        if (! path || ! *path) {
+                return;
         }
 
-        wbkgd(winHelp, attribStyle[cHelpWin]);
-        box(winHelp, 0, 0);
-
-        mvwaddstr(winHelp, 0,              (helpWidth - 6)                   / 2, " Help ");
-        mvwaddstr(winHelp, helpHeight - 1, (helpWidth - strlen(helpVersion)) / 2, helpVersion);
-
-        for (int i=0; i < helpHeight - 2; ++i) {  // exclude border
-                mvwaddstr(winHelp, i + 1, 1, aHelp[i]);
-        }
+        FILE *out = strcmp(path, "-") ? fopen(path, "w") : stdout;
 
-        for (int i=0; aBold[i]; i += 2) {
-                mvwchgat(winHelp, aBold[i], aBold[i + 1], 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+        if (! out) {
+                warn("%s", path);
+                return;
         }
 
-        if (! singleFile) {
-                diffs.resizeD();
-        }
+        fprintf(out, "{\"version\":\"%s\",\"simd\":\"%s\"", VBL_VERSION, kernel.name);
 
-        file1.initF(0, (singleFile ? NULL : &diffs));
+        for (int op = 0; op < opCount; ++op) {
+                const Metric& t = metrics[op];
+                double wall = t.wallNs / 1e9;
 
-        if (! singleFile) {
-                file2.initF(numLines + 1, &diffs);
+                fprintf(out, ",\"%s\":{\"runs\":%lu,\"bytesRead\":%lu,\"bytesWritten\":%lu,\"syscalls\":%lu,"
+                             "\"cacheHits\":%lu,\"cacheMisses\":%lu,\"seconds\":%.6f,\"cpuSeconds\":%.6f,\"gbps\":%.3f}",
+                        metricName[op], t.runs, t.bytesRead, t.bytesWritten, t.syscalls,
+                        t.cacheHits, t.cacheMisses, wall, t.cpuNs / 1e9,
+                        wall > 0 ? (t.bytesRead + t.bytesWritten) / wall / 1e9 : 0.0);
         }
-} // end setup
-
-//--------------------------------------------------------------------
-// Test progress bar
 
-void ee()
-{
-        for (int blocks = 25, naps = 4, go = 0; ;) {
-                for (int i=1; i;) {
-                        char buf[32];
-                        sprintf(buf, " %d %d ", blocks, naps);
-                        positionInWin(cmgGotoTop, 2+ blocks +2, buf);
+        fprintf(out, "}\n");
 
-                        if (! go++) break;
+        if (out != stdout) {
+                fclose(out);
+        }
+} // end reportMetrics
 
-                        flushinp();
-                        int key = wgetch(winInput);
+#if BENCHMARK || SELFTEST
+//====================================================================
+// Headless driver  ##:headless
+//
+// Curses on /dev/null, views reopened at will
 
-                        switch (key) {
-                                case KEY_UP:     if (naps < 50) ++naps; break;
-                                case KEY_DOWN:   if (naps >  0) --naps; break;
+void headlessInit(const string& path1, const string* path2)
+{
+        goHeadless();
 
-                                case KEY_LEFT:   if (blocks > 3) --blocks; file1.updateF(); break;
-                                case KEY_RIGHT:  if (blocks < screenWidth - 4) ++blocks;    break;
+        singleFile = ! path2;
 
-                                case KEY_ESCAPE:  file1.updateF(); return;
-                                default:          --i;
-                        }
-                }
+        if (! initialize() || ! file1.setFile(strdup(path1.c_str())) ||
+            (path2 && ! file2.setFile(strdup(path2->c_str())))) {
+                err(34, "headless setup");
+        }
 
-                wchar_t bar[blocks + 1];
-                memset(bar, 0, sizeof(bar));
+        setup();
+}
 
-                for (int i=0; i < blocks; ++i) {
-                        for (int j=0; j < 8; ++j) {
-                                bar[i] = barSyms[j];
+//--------------------------------------------------------------------
+// Point a view at another file
 
-                                mvwaddwstr(winInput, 1, 2, bar);
-                                wrefresh(winInput);
-                                napms(naps);
-                        }
-                }
-                napms(200);
+void reopen(FileDisplay& f, const string& path)
+{
+        if (f.fd > 0) {
+                close(f.fd);
         }
+
+        f.setFile(strdup(path.c_str()));
+        f.flush();
+
+        f.searchOff = f.scrollOff = 0;
+        f.moveTo(0);
 }
+#endif
 
-//--------------------------------------------------------------------
-// Get a file position and move there  ##:p
+#if BENCHMARK
+//====================================================================
+// Benchmark runner  ##:bench
+//
+// Synthetic files, warm page cache, best of three runs.
+// One JSON line per hot path: op, file, bytes, seconds, gbps
 
-void gotoPosition(Command cmd)
+double benchClock()
 {
-        positionInWin(cmd, inWidth + 1 + 4, " Goto ");  // cursor + border
+        timespec ts;
 
-        char buf[inWidth + 1];
+        clock_gettime(CLOCK_MONOTONIC, &ts);
 
-        getString(buf, inWidth, positionHistory, hexDigitsGoto);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
-        if (! buf[0]) {
-                return;
-        }
+//--------------------------------------------------------------------
+// random, zero, sparse, lines, near (as random, one bit in the last MB)
 
-        int rel = 0;
+string benchFile(const string& dir, const char* kind, Size size)
+{
+        string path = dir + "/vbl-bench-" + kind;
+        File   out  = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        Full   seed = 0x9E3779B97F4A7C15;
 
-        if (*buf == '+') {
-                ++rel;
+        if (out < 0) {
+                err(31, "%s", path.c_str());
         }
 
-        if (*buf == '-') {
-                --rel;
+        if (! strcmp(kind, "sparse")) {
+                if (ftruncate(out, size) == ERR || pwrite(out, "\1", 1, size - 1) != 1) {
+                        err(32, "%s", path.c_str());
+                }
         }
 
-        if (rel) {
-                *buf = ' ';
-        }
+        for (FPos pos = 0; strcmp(kind, "sparse") && pos < size; pos += staticSize) {
+                Size len = min((Size) staticSize, size - pos);
 
-        FPos pos1 = 0,
-             pos2 = 0;
+                for (Size i = 0; i < len; i += 8) {
+                        Full w = 0;
 
-        if (strchr(buf, '%')) {
-                int i = atoi(buf);
+                        if (*kind == 'r' || *kind == 'n') {  // xorshift64
+                                seed ^= seed << 13;
+                                seed ^= seed >> 7;
+                                seed ^= seed << 17;
+                                w = seed;
+                        }
+                        else if (*kind == 'l') {
+                                memcpy(&w, "quick brown fox\n" + i % 16, 8);  // rows repeat at any width
+                        }
 
-                if (i >= 1 && i <= 99) {
-                        pos1 = file1.filesize / 100 * i;
-                        pos2 = file2.filesize / 100 * i;
-                }
-                else if (i >= 100) {
-                        pos1 = file1.filesize - steps[cmmMovePage];
-                        pos2 = file2.filesize - steps[cmmMovePage];
+                        memcpy(buffer + i, &w, 8);
                 }
-        }
 
-        else if (strpbrk(buf, "ABCDEFXabcdefx")) {
-              pos1 = pos2 = strtoull(buf, NULL, 16);
-        }
+                if (*kind == 'n' && pos + len == size) {
+                        buffer[len - (1 << 20)] ^= 1;
+                }
 
-        else {
-              pos1 = pos2 = strtoull(buf, NULL, 10);
+                if (pwrite(out, buffer, len, pos) != len) {
+                        err(33, "%s", path.c_str());
+                }
         }
 
-        Size prefix = 1;
+        close(out);
 
-        const char* ptr = strpbrk(buf, sPrefix);
+        return path;
+}
 
-        if (ptr) {
-                ptr = strchr(sPrefix, *ptr);
+void benchReport(const char* op, const char* kind, Size bytes, double sec)
+{
+        printf("{\"op\":\"%s\",\"file\":\"%s\",\"simd\":\"%s\",\"bytes\":%ld,\"seconds\":%.6f,\"gbps\":%.3f}\n",
+                op, kind, kernel.name, bytes, sec, bytes / sec / 1e9);
+        fflush(stdout);
+}
 
-                prefix = aPrefix[ptr - sPrefix];
-        }
+//--------------------------------------------------------------------
+// Time run() three times, the best counts
 
-        pos1 *= prefix;
-        pos2 *= prefix;
+void benchRun(const char* op, const char* kind, const function<Size()>& run)
+{
+        double best  = 1e9;
+        Size   bytes = 0;
 
-        if (cmd & cmgGotoTop) {
-                if (rel) {
-                        file1.repeatOff = rel > 0 ? pos1 : -pos1;
-                        file1.move(file1.repeatOff);
-                }
+        for (int n = 0; n < 3; ++n) {
+                double t = benchClock();
 
-                else {
-                        file1.setLast();
-                        file1.moveTo(pos1);
-                }
+                bytes = run();
+                best  = min(best, benchClock() - t);
         }
 
-        if (cmd & cmgGotoBottom) {
-                if (rel) {
-                        file2.repeatOff = rel > 0 ? pos2 : -pos2;
-                        file2.move(file2.repeatOff);
-                }
-
-                else {
-                        file2.setLast();
-                        file2.moveTo(pos2);
-                }
-        }
-} // end gotoPosition
+        benchReport(op, kind, bytes, best);
+}
 
 //--------------------------------------------------------------------
-// Search for text or bytes in the files
 
-void searchFiles(Command cmd)
+int bench(int argc, char* argv[])
 {
-        const bool havePrev = !lastSearch.empty();
-        int key = 0;
+        string dir  = argc > 1 ? argv[1] : ".";
+        Size   size = (argc > 2 ? atol(argv[2]) : 256) << 20;
 
-        if (! ((cmd & cmfFindNext || cmd & cmfFindPrev) && havePrev)) {
-                positionInWin(cmd, (havePrev ? 36 : 18), " Find ");
+        const char *kinds[] = { "random", "zero", "sparse", "lines", "near" };
+        string      paths[5];
 
-                mvwaddstr(winInput, 1,  2, "H Hex");
-                mvwaddstr(winInput, 1, 10, "T Text");
+        for (int k = 0; k < 5; ++k) {
+                paths[k] = benchFile(dir, kinds[k], size);
+        }
 
-                mvwchgat(winInput, 1,  2, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
-                mvwchgat(winInput, 1, 10, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
+        headlessInit(paths[0], &paths[4]);
 
-                if (havePrev) {
-                        mvwaddstr(winInput, 1, 19, "N Next");
-                        mvwaddstr(winInput, 1, 28, "P Prev");
+        const Byte needle[] = "vbl-bench needle, not in any file";
+        Size       nLen     = sizeof(needle) - 1;
 
-                        mvwchgat(winInput,  1, 19, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
-                        mvwchgat(winInput,  1, 28, 1, attribStyle[cHotkey], colorStyle[cHotkey], NULL);
-                }
+        for (int k : { 0, 3 }) {
+                reopen(file1, paths[k]);
 
-                key = upCase(wgetch(winInput));
+                benchRun("moveForw", kinds[k], [&]() {
+                        file1.searchOff = 0;
+                        file1.moveTo(0);
+                        file1.moveForw(needle, nLen);
+                        return file1.filesize;
+                });
 
-                bool hex = false;
+                benchRun("moveBack", kinds[k], [&]() {
+                        file1.searchOff = 0;
+                        file1.moveTo(file1.filesize);
+                        file1.moveBack(needle, nLen);
+                        return file1.filesize;
+                });
 
-                if (key == KEY_ESCAPE) {
-                        return;
-                }
-                else if (key == 'H') {
-                        hex = true;
-                }
+                ignoreCase = true;
 
-                if (! ((key == 'N' || key == 'P') && havePrev)) {
-                        positionInWin(cmd, screenWidth, (hex ? " Find Hex Bytes " : " Find Text "));
+                benchRun("moveForwIgnoreCase", kinds[k], [&]() {
+                        file1.searchOff = 0;
+                        file1.moveTo(0);
+                        file1.moveForw(needle, nLen);
+                        return file1.filesize;
+                });
 
-                        int maxlen = screenWidth - 4 - 1;
+                ignoreCase = false;
+        }
 
-                        if (hex) {
-                                maxlen -= maxlen % 3;
-                        }
+        for (int k : { 1, 2 }) {
+                reopen(file1, paths[k]);
 
-                        char buf[maxlen + 1];
-                        int searchLen;
+                benchRun("seekNotChar", kinds[k], [&]() {
+                        file1.moveTo(0);
+                        file1.seekNotChar(false);
+                        return file1.offset;
+                });
+        }
 
-                        if (hex) {
-                                getString(buf, maxlen, hexSearchHistory, hexDigits, true, true);
+        reopen(file1, paths[3]);
 
-                                searchLen = packHex(buf);
-                        }
-                        else {
-                                getString(buf, maxlen, textSearchHistory);
+        benchRun("smartScroll", kinds[3], [&]() {
+                file1.scrollOff = 0;
+                file1.moveTo(0);
+                file1.smartScroll();
+                return file1.scrollOff;
+        });
 
-                                searchLen = strlen(buf);
-                        }
+        reopen(file1, paths[0]);
+        reopen(file2, paths[4]);
 
-                        if (! searchLen) {
-                                return;
-                        }
+        benchRun("speedup", kinds[4], [&]() {  // random against near
+                file1.moveTo(0);
+                file2.moveTo(0);
+                diffs.speedup(1);
+                return 2 * file1.offset;
+        });
 
-                        if (cmd & cmgGotoTop) {
-                                file1.setLast();
-                        }
+        reopen(file1, paths[0]);
 
-                        if (cmd & cmgGotoBottom) {
-                                file2.setLast();
-                        }
+        benchRun("WriteTail", kinds[0], [&]() {  // insert a byte up front
+                close(file1.fd);
+                file1.fd = OpenFile(file1.fileName, true);
 
-                        lastSearch.assign(buf, searchLen);
+                Journal jr(file1.fileName);
 
-                        lowCase((Byte*)buf, searchLen);
+                edits.init(file1.fd, SeekFile(file1.fd, 0, SEEK_END));
+                edits.insert(0, needle, 1);
+                edits.plan(jr);
 
-                        lastSearchIgnCase.assign(buf, searchLen);
-                }
+                Size remain = jr.remain();
 
-                if (! singleFile) {
-                        file2.updateF();  // kick remnants
+                if (! jr.create() || ! file1.WriteTail(jr)) {
+                        err(35, "WriteTail");
                 }
-        }
 
-        Byte* searchPattern = (Byte*) (ignoreCase ? lastSearchIgnCase.data() : lastSearch.data());
+                return remain;
+        });
 
-        if (cmd & cmfFindPrev || key == 'P') {
-                if (cmd & cmgGotoTop) {
-                        file1.busy(true);
+        shutdown();
 
-                        file1.moveBack(searchPattern, lastSearch.size());
-                        file1.busy();
-                }
+        for (const string& path : paths) {
+                unlink(path.c_str());
+        }
 
-                if (cmd & cmgGotoBottom) {
-                        file2.busy(true);
+        return 0;
+} // end bench
+#endif
 
-                        file2.moveBack(searchPattern, lastSearch.size());
-                        file2.busy();
-                }
-        }
-        else {
-                if (cmd & cmgGotoTop) {
-                        file1.busy(true);
+#if SELFTEST
+//====================================================================
+// Search self test  ##:test
+//
+// Random haystacks with the pattern planted across the staticSize
+// blocks (both walking directions), at file start and end and behind
+// zero runs.  Every kernel walks the same Next / Prev / jump sequence,
+// checked against a naive search.
 
-                        file1.moveForw(searchPattern, lastSearch.size());
-                        file1.busy();
-                }
+Full testSeed = 0x9E3779B97F4A7C15;
 
-                if (cmd & cmgGotoBottom) {
-                        file2.busy(true);
+Full testRand()  // xorshift64
+{
+        testSeed ^= testSeed << 13;
+        testSeed ^= testSeed >> 7;
+        testSeed ^= testSeed << 17;
 
-                        file2.moveForw(searchPattern, lastSearch.size());
-                        file2.busy();
-                }
-        }
-} // end searchFiles
+        return testSeed;
+}
+
+Byte testFold(Byte c)
+{
+        return ignoreCase && c >= 'A' && c <= 'Z' ? c | 0x20 : c;
+}
+
+const Byte testAlpha[] = { 0, 0, 'a', 'A', 'b', 'B', 'x', 'Z' };  // near misses
 
 //--------------------------------------------------------------------
-// Handle a command  ##:hand
+// Buffer kernels against plain loops, short and unaligned
 
-void handleCmd(Command cmd)
+int testKernels(const Kernels& k)
 {
-        if (cmd & cmgGoto) {
-                if (cmd & cmgGotoForw) {
-                        if (cmd & cmgGotoTop) {
-                                file1.skip();
-                        }
-                        if (cmd & cmgGotoBottom) {
-                                file2.skip();
-                        }
+        static Byte a[5000 + 64], b[5000 + 64], out[5000];
+        int fails = 0;
+
+        for (int n = 0; n < 20000 && fails < 5; ++n) {
+                Size len = testRand() % 5000,
+                     m   = 1 + testRand() % 12;
+                Byte pat[12 + 8];  // ScanForw reads whole words
+
+                for (Size i = 0; i < len + 64; ++i) {
+                        a[i] = testAlpha[testRand() % 8];
+                        b[i] = testRand() % 8 ? a[i] : a[i] ^ 1;
                 }
 
-                else if (cmd & cmgGotoBack) {
-                        if (cmd & cmgGotoTop) {
-                                file1.skip(true);
-                        }
-                        if (cmd & cmgGotoBottom) {
-                                file2.skip(true);
-                        }
+                for (Size j = 0; j < m; ++j) {
+                        pat[j] = testAlpha[testRand() % 8];
                 }
 
-                else if (cmd & cmgGotoLSet) {
-                        if (cmd & cmgGotoTop) {
-                                file1.setLast();
-                        }
-                        if (cmd & cmgGotoBottom) {
-                                file2.setLast();
+                FPos first = -1, last = -1, notFirst = -1, notLast = -1;
+                int  diffs = 0;
+
+                for (Size i = 0; i + m <= len; ++i) {
+                        if (! memcmp(a + i, pat, m)) {
+                                last  = i;
+                                first = first < 0 ? i : first;
                         }
                 }
 
-                else if ((cmd & cmgGotoMask) == cmgGotoLGet) {
-                        if (cmd & cmgGotoTop) {
-                                file1.getLast();
-                        }
-                        if (cmd & cmgGotoBottom) {
-                                file2.getLast();
+                for (Size i = 0; i < len; ++i) {
+                        if (a[i] != *a) {
+                                notLast  = i;
+                                notFirst = notFirst < 0 ? i : notFirst;
                         }
+
+                        diffs += a[i] != b[i];
                 }
 
-                else if ((cmd & cmgGotoMask) == cmgGotoLOff) {
-                        if (cmd & cmgGotoTop) {
-                                file1.move(file1.repeatOff);
-                        }
-                        if (cmd & cmgGotoBottom) {
-                                file2.move(file2.repeatOff);
-                        }
+                const char *what = ScanForw(a, len, pat, m) != first ? "ScanForw" :
+                                   k.scan(a, len, pat, m, false) != first ? "scan" :
+                                   k.scan(a, len, pat, m, true)  != last  ? "scan back" :
+                                   k.notByte(a, len, *a, false) != notFirst ? "notByte" :
+                                   k.notByte(a, len, *a, true)  != notLast  ? "notByte back" :
+                                   k.diff(a, b, out, len) != diffs ? "diff" : NULL;
+
+                for (Size i = 0; ! what && i < len; ++i) {
+                        what = out[i] != (a[i] != b[i]) ? "diff mark" : NULL;
                 }
 
-                else if ((cmd & cmgGotoMask) == cmgGotoNOff) {
-                        if (cmd & cmgGotoTop) {
-                                file1.move(-file1.repeatOff);
-                        }
-                        if (cmd & cmgGotoBottom) {
-                                file2.move(-file2.repeatOff);
-                        }
+                ignoreCase = true;
+                k.lowCase(b, len);
+
+                for (Size i = 0; ! what && i < len; ++i) {
+                        what = b[i] != testFold(a[i] ^ (out[i] ? 1 : 0)) ? "lowCase" : NULL;
                 }
 
-                else {
-                        gotoPosition(cmd);
+                if (what) {
+                        printf("FAIL %s %s: len %ld pattern %ld\n", k.name, what, len, m);
+                        ++fails;
                 }
         }
 
-        else if (cmd & cmfFind) {
-                if (cmd & cmfNotCharDn) {
-                        if (cmd & cmgGotoTop) {
-                                file1.busy(true);
+        return fails;
+} // end testKernels
 
-                                file1.seekNotChar();
-                                file1.busy();
-                        }
+//--------------------------------------------------------------------
+// One haystack file, every kernel through moveForw / moveBack
 
-                        if (cmd & cmgGotoBottom) {
-                                file2.busy(true);
+int testSearch(const string& path, int round, const vector<const Kernels*>& kernels)
+{
+        Size size = round % 3 == 0 ? testRand() % 200 :
+                    round % 3 == 1 ? (1 << 20) + testRand() % 4096 :
+                                     2 * staticSize + testRand() % (staticSize / 2);
 
-                                file2.seekNotChar();
-                                file2.busy();
-                        }
+        vector<Byte> hay(size);
+
+        for (Size i = 0; i < size;) {  // runs of zeros, near misses, noise
+                Size run  = min<Size>(1 + testRand() % 65536, size - i);
+                int  kind = testRand() % 3;
+
+                for (Size end = i + run; i < end; ++i) {
+                        Full r = testRand();
+
+                        hay[i] = kind == 0 ? 0 : (kind == 1 ? testAlpha[r % 8] : r);
                 }
+        }
 
-                else if (cmd & cmfNotCharUp) {
-                        if (cmd & cmgGotoTop) {
-                                file1.busy(true);
+        ignoreCase = testRand() % 2;
 
-                                file1.seekNotChar(true);
-                                file1.busy();
-                        }
+        Size   m     = 1 + testRand() % 40,
+               zeros = testRand() % 3 ? 0 : testRand() % m;
+        string pat(m, 0);
 
-                        if (cmd & cmgGotoBottom) {
-                                file2.busy(true);
+        pat.reserve(m + 8);
 
-                                file2.seekNotChar(true);
-                                file2.busy();
+        for (Size j = zeros; j < m; ++j) {
+                pat[j] = testFold(testAlpha[testRand() % 8]);
+        }
+
+        vector<FPos> edge, at;  // candidates, a few planted
+
+        if (size >= m) {
+                edge = { 0, (FPos) (size - m) };
+
+                for (FPos step : { (FPos) staticSize, (FPos) (staticSize - m + 1) }) {
+                        for (FPos e = step; e < size; e += step) {
+                                for (FPos d : { (FPos) -2, (FPos) -1, (FPos) 0, (FPos) 1, (FPos) m / 2, (FPos) m - 1 }) {
+                                        edge.push_back(e - d);
+                                        edge.push_back(size - m + 1 - e - d);
+                                }
                         }
                 }
 
-                else {
-                        searchFiles(cmd);
+                for (int n = 0; n < 8; ++n) {
+                        at.push_back(n < 6 ? edge[testRand() % edge.size()] : testRand() % (size - m + 1));
                 }
         }
 
-        else if (cmd & cmmMove) {
-                int step = steps[cmd & cmmMoveMask];
-
-                if (! (cmd & cmmMoveForward)) {
-                        step *= -1;
+        for (FPos p : at) {
+                for (Size j = 0; p >= 0 && p + m <= size && j < m; ++j) {
+                        hay[p + j] = pat[j] ^ (isalpha(pat[j]) && ignoreCase && testRand() % 2 ? 0x20 : 0);
                 }
+        }
 
-                if ((cmd & cmmMoveForward) && ! step) {  // special case first
-                        if (cmd & cmgGotoTop) {
-                                file1.setLast();
-                                file1.moveToEnd();
-                        }
+        int    bits = 1 + testRand() % 3;  // shift, xor or both
+        Size   mb   = 3 + testRand() % 6;
+        string pb(mb, 0);
 
-                        if (cmd & cmgGotoBottom) {
-                                file2.setLast();
-                                file2.moveToEnd();
-                        }
+        for (Size j = 0; j < mb; ++j) {
+                pb[j] = testRand();
+        }
+
+        for (int n = 0; n < 8 && size > (Size) mb; ++n) {  // bit-shifted, xored copies
+                FPos p   = n < 4 && at.size() ? at[n] : testRand() % (size - mb);
+                int  sh  = bits & bitsShift && n % 2 ? 1 + testRand() % 7 : 0;
+                Byte key = bits & bitsXor ? testRand() : 0;
+
+                if (p < 0 || p + (FPos) mb >= size) {
+                        continue;
                 }
 
-                else {
-                        if (cmd & cmgGotoTop) {
-                                if (step) {
-                                        file1.move(step);
-                                }
-                                else {
-                                        file1.setLast();
-                                        file1.moveTo(0);
-                                }
-                        }
+                for (Size j = 0; j < mb; ++j) {  // the bits of pb from bit sh of p on
+                        hay[p + j]     = (hay[p + j]     & ~(0xFF >> sh)) | (Byte) pb[j] >> sh;
+                        hay[p + j + 1] = (hay[p + j + 1] &  (0xFF >> sh)) | (Byte) (pb[j] << (8 - sh));
+                }
 
-                        if (cmd & cmgGotoBottom) {
-                                if (step) {
-                                        file2.move(step);
-                                }
-                                else {
-                                        file2.setLast();
-                                        file2.moveTo(0);
-                                }
-                        }
+                for (Size j = 0; j <= mb; ++j) {
+                        hay[p + j] ^= key;
                 }
         }
 
-        else if (cmd == cmSyncUp) {
-                file1.sync(&file2);
-        }
+        File out = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
 
-        else if (cmd == cmSyncDn) {
-                file2.sync(&file1);
+        if (out < 0 || write(out, hay.data(), size) != size) {
+                err(33, "%s", path.c_str());
         }
 
-        else if (cmd == cmNextDiff || cmd == cmPrevDiff) {
-                int size = cmd == cmNextDiff ? bufSize : -bufSize;
+        close(out);
 
-                if (lockState) {
-                        lockState = lockNeither;
-                }
+        vector<FPos> hits;
 
-                file1.busy(true);
-                file2.busy(true);
+        for (FPos i = 0; i + m <= size; ++i) {
+                Size j = 0;
 
-                if (haveDiff) {
-                        file1.move(size);
-                        file2.move(size);
+                while (j < m && testFold(hay[i + j]) == (Byte) pat[j]) {
+                        ++j;
                 }
 
-                for (int go=1; ! diffs.compute(cmd) && ! stopRead; go=0) {
-                        if (go) {
-                                diffs.speedup(size);
+                if (j == m) {
+                        hits.push_back(i);
+                }
+        }
 
-                                file1.move(0);
-                                file2.move(0);
+        vector<FPos> bitHits, fuzzyHits, valueHits;  // the same walks for moveScan
+
+        auto stream = [&](FPos p, int sh) {  // byte p of the bits search, shifted
+                int b = bits & bitsXor ? hay[p] ^ hay[p + 1] : hay[p];
+                int c = ! sh ? 0 : bits & bitsXor ? hay[p + 1] ^ hay[p + 2] : hay[p + 1];
+
+                return (Byte) (b << sh | c >> (8 - sh));
+        };
+
+        Size tLen = mb - (bits & bitsXor ? 1 : 0);
+        Byte target[mb];
+
+        for (Size j = 0; j < tLen; ++j) {
+                target[j] = bits & bitsXor ? pb[j] ^ pb[j + 1] : pb[j];
+        }
+
+        for (FPos i = 0; i + (FPos) mb <= size; ++i) {
+                for (int sh = 0; sh < (bits & bitsShift ? 8 : 1); ++sh) {
+                        Size j = 0;
+
+                        while (j < tLen && (! sh || i + (FPos) mb < size) && stream(i + j, sh) == target[j]) {
+                                ++j;
                         }
 
-                        else {
-                                file1.move(size);
-                                file2.move(size);
+                        if (j == tLen) {
+                                bitHits.push_back(i);
+                                break;
                         }
                 }
-
-                file1.busy();
-                file2.busy();
         }
 
-        else if (cmd == cmUseTop) {
-                if (lockState == lockBottom) {
-                        lockState = lockNeither;
+        Size fuzzy = 1 + testRand() % min<Size>(3, max<Size>(m - 1, 1));  // bytes that may differ
+
+        for (FPos i = 0; m > fuzzy && i + (FPos) m <= size; ++i) {
+                Size miss = 0;
+
+                for (Size j = 0; j < m && miss <= fuzzy; ++j) {
+                        miss += testFold(hay[i + j]) != (Byte) pat[j];
                 }
-                else {
-                        lockState = lockBottom;
+
+                if (miss <= fuzzy) {
+                        fuzzyHits.push_back(i);
                 }
         }
 
-        else if (cmd == cmUseBottom) {
-                if (lockState == lockTop) {
-                        lockState = lockNeither;
-                }
-                else {
-                        lockState = lockTop;
+        FPos  v0 = size >= 2 ? testRand() % (size - 1) : 0;
+        Full  lo = size >= 2 ? hay[v0] | hay[v0 + 1] << 8 : 0,
+              hi = min<Full>(lo + testRand() % 3, 0xFFFF);
+        char  query[48];
+        ValueQuery q;
+
+        sprintf(query, "u16 %lu..%lu", lo, hi);
+        parseValue(query, q);
+
+        for (FPos i = 0; i + 2 <= size; ++i) {
+                Full v = hay[i] | hay[i + 1] << 8;
+
+                if (v >= lo && v <= hi) {
+                        valueHits.push_back(i);
                 }
         }
 
-        else if (cmd == cmShowAscii) {
-                modeAscii ^= true;
+        Full seed  = testSeed;
+        int  fails = 0;
 
-                setViewMode();
-                file1.resizeF();
-                file1.move(0);
-        }
+        // Next / Prev from anywhere, as moveScan reads: need bytes per hit,
+        // backwards the window ends need - 1 bytes behind the last hit
 
-        else if (cmd == cmIgnoreCase) {
-                file1.busy(true, true);
-                file2.busy(true, true);
+        auto walk = [&](const char* what, const vector<FPos>& want, Size need, const function<void(bool)>& move) {
+                FPos off = testRand() % (size + 1),
+                     s   = 0;
 
-                ignoreCase ^= true;
-                file1.busy(false, true);
-                file2.busy(false, true);
-        }
+                file1.searchOff = 0;
+                file1.moveTo(off);
 
-        else if (cmd == cmShowRaster) {
-                showRaster ^= true;
-        }
+                for (int n = 0; n < 24 && ! fails; ++n) {
+                        bool back = testRand() % 2;
+                        FPos hit  = -1;
 
-        else if (cmd == cmShowHelp) {
-                displayHelp();
-        }
+                        if (back) {
+                                FPos end = min<FPos>((s > 0 ? s : off) + need - 1, size);
+                                auto it  = upper_bound(want.begin(), want.end(), end - (FPos) need);
 
-        else if (cmd == cmEditTop && ! modeAscii) {
-                file1.display();  // reset smartscroll
-                file1.highEdit(screenWidth);
+                                hit = it == want.begin() ? -1 : *--it;
+                        }
+                        else {
+                                FPos from = s > 0 ? s + 1 : (s < 0 ? 1 : off);
+                                auto it   = lower_bound(want.begin(), want.end(), from);
 
-                file1.edit(singleFile ? NULL : &file2);
-        }
+                                hit = it == want.end() || size - from < need ? -1 : *it;
+                        }
 
-        else if (cmd == cmEditBottom) {
-                file2.highEdit(screenWidth);
+                        move(back);
 
-                file2.edit(&file1);
-        }
+                        if (hit < 0) {
+                                s   = 0;
+                                off = back ? 0 : size;
+                        }
+                        else {
+                                s   = hit ? hit : -1;
+                                off = max<FPos>(hit - (s >= searchIndent ? searchIndent : 0), 0);
+                        }
 
-        else if (cmd == cmSmartScroll) {
-                file1.busy(true);
+                        if (file1.searchOff != s || file1.offset != off) {
+                                printf("FAIL %s %s %s: file %ld, searchOff %ld offset %ld, want %ld %ld\n",
+                                        kernel.name, what, back ? "prev" : "next",
+                                        size, file1.searchOff, file1.offset, s, off);
+                                ++fails;
+                        }
+                }
+        };
 
-                file1.smartScroll();
-                file1.busy();
-        }
+        for (const Kernels* k : kernels) {
+                kernel   = *k;
+                testSeed = seed;  // same walk for every kernel
 
-        file1.display();
-        file2.display();
+                reopen(file1, path);
 
-        if (stopRead) {
-                stopRead = false;
-                napms(500);
-                flushinp();
-        }
-} // end handleCmd
+                FPos off = 0,
+                     s   = 0;  // model of offset, searchOff
 
-//--------------------------------------------------------------------
-// Get a command from keyboard  ##:get
+                for (int n = 0; n < 60 && ! fails; ++n) {
+                        if (testRand() % 4 == 0) {  // jump anywhere, or a block before a plant
+                                FPos way  = (FPos) (testRand() % 3) - 1,
+                                     step = staticSize - m + 1;
 
-Command getCommand()
-{
-        Command cmd = cmNothing;
+                                off = at.size() && testRand() % 4 ? at[testRand() % at.size()] + way * step :
+                                                                    testRand() % (size + 1);
+                                off = max<FPos>(min<FPos>(off + (FPos) (testRand() % 3) - 1, size), 0);
+                                s   = 0;
 
-        while (cmd == cmNothing) {
-                int key = file1.readKeyF();
+                                file1.searchOff = 0;
+                                file1.moveTo(off);
+                                continue;
+                        }
 
-                switch (upCase(key)) {
-                        case KEY_RIGHT:      cmd = cmmMove | cmmMoveByte | cmmMoveForward; break;
-                        case KEY_DOWN:       cmd = cmmMove | cmmMoveLine | cmmMoveForward; break;
-                        case ' ':            cmd = cmmMove | cmmMovePage | cmmMoveForward; break;
-                        case KEY_END:        cmd = cmmMove | cmmMoveAll  | cmmMoveForward; break;
-                        case KEY_LEFT:       cmd = cmmMove | cmmMoveByte;                  break;
-                        case KEY_UP:         cmd = cmmMove | cmmMoveLine;                  break;
-                        case KEY_BACKSPACE:  cmd = cmmMove | cmmMovePage;                  break;
-                        case KEY_HOME:       cmd = cmmMove | cmmMoveAll;                   break;
+                        bool back = testRand() % 2;
+                        FPos from = back ? min<FPos>(s > 0 ? s : off, size - m + 1) :
+                                           (s > 0 ? s + 1 : (s < 0 ? 1 : off));
 
-                        case 'F':        cmd = cmfFind;                break;
-                        case 'N':        cmd = cmfFind | cmfFindNext;  break;
-                        case 'P':        cmd = cmfFind | cmfFindPrev;  break;
-                        case KEY_NPAGE:  cmd = cmfFind | cmfNotCharDn; break;
-                        case KEY_PPAGE:  cmd = cmfFind | cmfNotCharUp; break;
+                        auto it   = lower_bound(hits.begin(), hits.end(), from);
+                        FPos want = back ? (it == hits.begin() ? -1 : *--it) :
+                                           (it == hits.end()   ? -1 : *it);
 
-                        case 'G':  cmd = cmgGoto;               break;
-                        case '+':
-                        case '*':
-                        case '=':  cmd = cmgGoto | cmgGotoForw; break;
-                        case '-':  cmd = cmgGoto | cmgGotoBack; break;
-                        case '\'':
-                        case '<':  cmd = cmgGoto | cmgGotoLGet; break;
-                        case 'L':  cmd = cmgGoto | cmgGotoLSet; break;
-                        case '.':  cmd = cmgGoto | cmgGotoLOff; break;
-                        case ',':  cmd = cmgGoto | cmgGotoNOff; break;
+                        back ? file1.moveBack((Byte*) pat.data(), m) : file1.moveForw((Byte*) pat.data(), m);
 
-                        case 'E':  cmd = lockState == lockTop ? cmEditBottom : cmEditTop; break;
+                        if (want < 0) {
+                                s   = 0;
+                                off = back ? 0 : size;
+                        }
+                        else {
+                                s   = want ? want : -1;
+                                off = max<FPos>(want - (s >= searchIndent ? searchIndent : 0), 0);
+                        }
 
-                        case KEY_RETURN:  cmd = singleFile ? cmSmartScroll : cmNextDiff; break;
+                        if (file1.searchOff != s || file1.offset != off) {
+                                printf("FAIL %s %s%s: file %ld pattern %ld (%ld zeros) from %ld, "
+                                       "searchOff %ld offset %ld, want %ld %ld\n",
+                                        k->name, back ? "moveBack" : "moveForw", ignoreCase ? " ignoreCase" : "",
+                                        size, m, zeros, from, file1.searchOff, file1.offset, s, off);
+                                ++fails;
+                        }
+                }
 
-                        case '#':
-                        case '\\': if (! singleFile) cmd = cmPrevDiff; break;
+                walk(bits == bitsShift ? "moveBits S" : bits == bitsXor ? "moveBits X" : "moveBits A",
+                        bitHits, mb + (bits & bitsShift ? 1 : 0), [&](bool back) {
+                        file1.moveBits((Byte*) pb.data(), mb, bits, back);
+                });
 
-                        case 'T':  if (! singleFile) cmd = cmUseTop;    break;
-                        case 'B':  if (! singleFile) cmd = cmUseBottom; break;
+                if (m > fuzzy) {
+                        walk("moveFuzzy", fuzzyHits, m, [&](bool back) {
+                                file1.moveFuzzy((Byte*) pat.data(), m, fuzzy, back);
+                        });
+                }
 
-                        case '1':  if (! singleFile) cmd = cmSyncUp; break;
-                        case '2':  if (! singleFile) cmd = cmSyncDn; break;
+                walk("moveValue", valueHits, 2, [&](bool back) {
+                        file1.moveValue(q, back);
+                });
+        }
 
-                        case 'A':  if (singleFile) cmd = cmShowAscii; break;
+        return fails;
+} // end testSearch
 
-                        case 'I':  cmd = cmIgnoreCase; break;
+//--------------------------------------------------------------------
 
-                        case 'R':  cmd = cmShowRaster; break;
+int selfTest(int argc, char* argv[])
+{
+        string dir    = argc > 1 ? argv[1] : ".";
+        int    rounds = argc > 2 ? atoi(argv[2]) : 24;
+        string path   = dir + "/vbl-test-hay";
 
-                        case 'H':  cmd = cmShowHelp; break;
+        if (argc > 3) {
+                testSeed = strtoul(argv[3], NULL, 0);
+        }
 
-                        case 'Z':  ee(); break;
+        printf("seed %#lx\n", testSeed);
 
-                        case KEY_ESCAPE:
-                                if (! singleFile && lockState != lockNeither)
-                                        cmd = lockState == lockTop ? cmUseBottom : cmUseTop;
-                                break;  // better off w/o Esc
+        vector<const Kernels*> kernels = { &kernels_generic };
 
-                        case KEY_CTRL_C:
-                        case 'Q':  cmd = cmQuit; break;
-                }
+#if defined(__x86_64__)
+        kernels.push_back(&kernels_sse2);
+
+        if (__builtin_cpu_supports("avx2")) {
+                kernels.push_back(&kernels_avx2);
         }
 
-        if (cmd & (cmmMove | cmfFind | cmgGoto)) {
-                if (lockState != lockTop)
-                        cmd |= cmgGotoTop;
+        if (__builtin_cpu_supports("avx512bw")) {
+                kernels.push_back(&kernels_avx512);
+        }
+#endif
 
-                if (lockState != lockBottom && ! singleFile)
-                        cmd |= cmgGotoBottom;
+        File out = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+        if (out < 0) {
+                err(31, "%s", path.c_str());
         }
 
-        return cmd;
-} // end getCommand
+        close(out);
+
+        headlessInit(path, NULL);
+
+        int fails = 0;
+
+        for (const Kernels* k : kernels) {
+                fails += testKernels(*k);
+        }
+
+        for (int round = 0; round < rounds && ! fails; ++round) {
+                fails += testSearch(path, round, kernels);
+        }
+
+        shutdown();
+        unlink(path.c_str());
+
+        printf("%s: %ld kernels, %d rounds\n", fails ? "FAILED" : "ok", kernels.size(), rounds);
+
+        return fails ? 1 : 0;
+} // end selfTest
+#endif
 
 //====================================================================
 // Main Program  ##:main
 
 int main(int argc, char* argv[])
 {
+#if BENCHMARK
+        return bench(argc, argv);
+#endif
+#if SELFTEST
+        return selfTest(argc, argv);
+#endif
+
         char* prog = strrchr(*argv, '/');
 
         prog = prog ? prog + 1 : *argv;
 
-        printf("%s\n\n", helpVersion + 1);
+        const char *recordPath = getenv("VBL_RECORD"),
+                   *replayPath = getenv("VBL_REPLAY");
+
+        if (! replayPath) {
+                printf("%s\n\n", helpVersion + 1);
+        }
 
         if (argc == 1) {
-                printf("\t%s file [file2] [addr] [addr2]\n"
+                printf("\t%s file [file2 [more files]] [addr] [addr2]\n"
                         "\n"
                         "// type 'h' for help\n"
                         "\n",
@@ -3186,6 +9491,8 @@ int main(int argc, char* argv[])
 
         singleFile = true;
 
+        int more = 3;  // first arg after the pair
+
         if (argc > 2) {
                 File probe = OpenFile(argv[2]);
 
@@ -3201,11 +9508,17 @@ int main(int argc, char* argv[])
                         }
                 }
 
-                if (! singleFile && argv[3]) {
-                        file1.startAddr = strtoull(argv[3], NULL, 0);
+                while (! singleFile && argv[more] && (probe = OpenFile(argv[more])) > 0) {  // views below
+                        close(probe);
+                        views.push_back(new FileDisplay());
+                        ++more;
+                }
+
+                if (! singleFile && argv[more]) {
+                        file1.startAddr = strtoull(argv[more], NULL, 0);
 
-                        if (argv[4]) {
-                                file2.startAddr = strtoull(argv[4], NULL, 0);
+                        if (argv[more + 1]) {
+                                file2.startAddr = strtoull(argv[more + 1], NULL, 0);
                         }
                         else {
                                 file2.startAddr = file1.startAddr;
@@ -3213,6 +9526,14 @@ int main(int argc, char* argv[])
                 }
         }
 
+        if (replayPath) {
+                goHeadless();
+
+                if (! loadSession(replayPath)) {
+                        err(13, "%s", replayPath);
+                }
+        }
+
         if (! initialize()) {
                 err(11, "Unable to initialize ncurses");
         }
@@ -3232,30 +9553,62 @@ int main(int argc, char* argv[])
                 err = string("File is too big: ") + argv[2];
         }
 
+        for (size_t i = 0; i < views.size() && err.empty(); ++i) {
+                if (! views[i]->setFile(argv[3 + i])) {
+                        err = string("Unable to open ") + argv[3 + i] + ": " + strerror(errno);
+                }
+        }
+
+        panes = (singleFile ? 1 : 2) + views.size();
+
+        if (LINES / panes - 1 < minViewLines) {
+                err = "Too many files for the screen.";
+        }
+
+        if (recordPath && ! replayPath && ! (recordFile = fopen(recordPath, "w"))) {
+                err = string("Unable to record to ") + recordPath + ": " + strerror(errno);
+        }
+
         if (err.size()) {
                 exitMsg(12, err.c_str());
         }
 
+        if (recordFile) {
+                fprintf(recordFile, "#%s%s %s\ns %d %d\n", helpVersion, argv[1], singleFile ? "" : argv[2], COLS, LINES);
+                fflush(recordFile);
+        }
+
         setup();
 
+        file1.resume();
+
+        if (! singleFile) {
+                file2.resume();
+        }
+
         file1.display();
         file2.display();
 
-        for (Command cmd; (cmd = getCommand()) != cmQuit; handleCmd(cmd)) {
-                if (! (cmd & cmfFind && ! (cmd & (cmfNotCharDn | cmfNotCharUp | cmgGoto)))) {
-                        file1.searchOff = file2.searchOff = 0;
-                }
-
-                if (! (cmd == cmNextDiff || cmd == cmPrevDiff)) {
-                        haveDiff = 0;
-                }
+        for (FileDisplay *view : views) {
+                view->display();
+        }
 
-                if (cmd != cmSmartScroll) {
-                        file1.scrollOff = 0;
+        if (replayPath) {
+                replaySession();
+        }
+        else {
+                for (Command cmd; (cmd = getCommand()) != cmQuit;) {
+                        runCommand(cmd);
                 }
         }
 
         shutdown();
 
+        if (recordFile) {
+                fclose(recordFile);
+        }
+
+        reportMetrics();
+
         return 0;
 }